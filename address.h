@@ -0,0 +1,105 @@
+#ifndef ADDRESS_H
+#define ADDRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "main_memory.h"
+
+// An address is split into | tag | set index | block offset |. The widths
+// come from the runtime cache geometry; when the block size and set count are
+// both powers of two the split is a shift and a mask, otherwise it falls back
+// to division.
+typedef struct addr_layout
+{
+    size_t block_size;
+    unsigned int num_sets;
+    int pow2;                   // 1 when block_size and num_sets are powers of two
+    unsigned int offset_bits;   // log2(block_size), valid when pow2
+    uintptr_t offset_mask;      // block_size - 1, valid when pow2
+    uintptr_t index_mask;       // num_sets - 1, valid when pow2
+} addr_layout;
+
+typedef struct addr_parts
+{
+    size_t offset;              // offset of the address within its block
+    void* block_start;          // start address of the block
+    uintptr_t block;            // block number
+    unsigned int set;           // set index
+} addr_parts;
+
+static inline int addr_is_pow2(size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+static inline unsigned int addr_log2(size_t n)
+{
+    unsigned int result = 0;
+    while (n >>= 1)
+        ++result;
+    return result;
+}
+
+static inline void addr_layout_init(addr_layout* l, size_t block_size,
+                                    unsigned int num_sets)
+{
+    l->block_size = block_size;
+    l->num_sets = num_sets;
+    l->pow2 = addr_is_pow2(block_size) && addr_is_pow2(num_sets);
+    l->offset_bits = addr_log2(block_size);
+    l->offset_mask = block_size - 1;
+    l->index_mask = num_sets - 1;
+}
+
+static inline uintptr_t addr_raw(void* addr)
+{
+    return (uintptr_t) addr - MAIN_MEMORY_START_ADDR;
+}
+
+// Splits addr according to l. Callers on the hot path pass a constant pow2 so
+// the compiler drops the branch and specializes the arithmetic.
+static inline void addr_split(const addr_layout* l, void* addr, int pow2,
+                              addr_parts* p)
+{
+    uintptr_t raw = addr_raw(addr);
+    if (pow2)
+    {
+        p->offset = raw & l->offset_mask;
+        p->block = raw >> l->offset_bits;
+        p->set = p->block & l->index_mask;
+    }
+    else
+    {
+        p->offset = raw % l->block_size;
+        p->block = raw / l->block_size;
+        p->set = p->block % l->num_sets;
+    }
+    p->block_start = addr - p->offset;
+}
+
+// Offset of addr within its memory block
+static inline size_t addr_offset(const addr_layout* l, void* addr)
+{
+    addr_parts p;
+    addr_split(l, addr, l->pow2, &p);
+    return p.offset;
+}
+
+// Start address of the memory block containing addr
+static inline void* addr_block_start(const addr_layout* l, void* addr)
+{
+    addr_parts p;
+    addr_split(l, addr, l->pow2, &p);
+    return p.block_start;
+}
+
+// Set index of addr
+static inline unsigned int addr_set_index(const addr_layout* l, void* addr)
+{
+    addr_parts p;
+    addr_split(l, addr, l->pow2, &p);
+    return p.set;
+}
+
+#endif
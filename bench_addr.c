@@ -0,0 +1,107 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#include "address.h"
+#include "set_associative.h"
+
+// Microbenchmark comparing the old string-based set index computation with
+// the shift-and-mask helpers in address.h.
+
+#define BENCH_NUM_ADDRS 4096
+#define BENCH_DEFAULT_ITERS 2000
+
+// Old path, kept verbatim for comparison
+static char *getBinary(unsigned int num)
+{
+    char* bstring;
+    int i;
+    bstring = (char*) malloc(sizeof(char) * 33);
+    bstring[32] = '\0';
+    for( i = 0; i < 32; i++ )
+    {
+        bstring[32 - 1 - i] = (num == ((1 << i) | num)) ? '1' : '0';
+    }
+    return bstring;
+}
+
+static int legacy_addr_to_set(void* addr)
+{
+    int intaddr = (uintptr_t)addr;
+    char* baddr = getBinary(intaddr);
+
+    int setbits = log2(SET_ASSOCIATIVE_NUM_SETS);
+    int setindex = 0;
+    int startidx = 32 - MAIN_MEMORY_BLOCK_SIZE_LN - setbits;
+    int i;
+    for (i = 0; i<setbits; i++){
+        int x = baddr[startidx + i] - '0';
+        setindex += x * pow(2.0, (setbits -1 - i));
+    }
+    free(baddr);
+    return setindex;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+    int iters = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_ITERS;
+    if (iters <= 0)
+    {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        exit(1);
+    }
+
+    addr_layout layout;
+    addr_layout_init(&layout, MAIN_MEMORY_BLOCK_SIZE, SET_ASSOCIATIVE_NUM_SETS);
+
+    void* addrs[BENCH_NUM_ADDRS];
+    srand(1);
+    int i;
+    for (i = 0; i < BENCH_NUM_ADDRS; i++)
+        addrs[i] = (void*) (uintptr_t) ((rand() % MAIN_MEMORY_SIZE) & ~3);
+
+    // Both paths must agree before we time them
+    for (i = 0; i < BENCH_NUM_ADDRS; i++)
+    {
+        if (legacy_addr_to_set(addrs[i])
+            != (int) addr_set_index(&layout, addrs[i]))
+        {
+            fprintf(stderr, "Error: set index mismatch at %p\n", addrs[i]);
+            exit(2);
+        }
+    }
+
+    // volatile sink keeps the compiler from discarding the loops
+    volatile unsigned int sink = 0;
+    long n = (long) iters * BENCH_NUM_ADDRS;
+    int it;
+
+    double start = now_ns();
+    for (it = 0; it < iters; it++)
+        for (i = 0; i < BENCH_NUM_ADDRS; i++)
+            sink += legacy_addr_to_set(addrs[i]);
+    double legacy_ns = (now_ns() - start) / n;
+
+    start = now_ns();
+    for (it = 0; it < iters; it++)
+        for (i = 0; i < BENCH_NUM_ADDRS; i++)
+            sink += addr_set_index(&layout, addrs[i]);
+    double fast_ns = (now_ns() - start) / n;
+
+    printf("accesses:\t%ld\n", n);
+    printf("string path:\t%.2lf ns/access\n", legacy_ns);
+    printf("shift path:\t%.2lf ns/access\n", fast_ns);
+    printf("speedup:\t%.1lfx\n", legacy_ns / fast_ns);
+
+    return 0;
+}
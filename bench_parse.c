@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+// Parse-only benchmark: getline + sscanf, as main used to read traces,
+// against the streaming trace_text_reader. Uses the given text trace, or a
+// synthetic one when no file is given.
+
+#define BENCH_SYNTHETIC_LINES 2000000
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// Old path, kept for comparison
+static unsigned long legacy_parse(FILE* input_file, unsigned long* checksum)
+{
+    char* line = 0;
+    size_t line_len = 0;
+    unsigned long records = 0;
+    while (getline(&line, &line_len, input_file) != -1)
+    {
+        char RW;
+        void* addr;
+        unsigned int val;
+
+        int tolkens_found = sscanf(line, "%c %p %d", &RW, &addr, &val);
+
+        if (strlen(line) != 1 && RW != '#')
+        {
+            if ((RW == 'R' && tolkens_found == 2)
+                || (RW == 'W' && tolkens_found == 3))
+            {
+                ++records;
+                *checksum += (uintptr_t) addr + (RW == 'W' ? val : 0);
+            }
+        }
+    }
+    free(line);
+    return records;
+}
+
+static unsigned long fast_parse(int fd, unsigned long* checksum)
+{
+    trace_text_reader ttr;
+    ttr_init_fd(&ttr, fd);
+    trace_record r;
+    unsigned long records = 0;
+    while (ttr_next(&ttr, &r))
+    {
+        ++records;
+        *checksum += r.addr + r.val;
+    }
+    ttr_close(&ttr);
+    return records;
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* input_file;
+    if (argc > 1)
+    {
+        input_file = fopen(argv[1], "r");
+        if (input_file == 0)
+        {
+            fprintf(stderr, "Error: Could not open %s.\n", argv[1]);
+            exit(3);
+        }
+    }
+    else
+    {
+        input_file = tmpfile();
+        srand(1);
+        int i;
+        for (i = 0; i < BENCH_SYNTHETIC_LINES; i++)
+        {
+            unsigned int addr = (rand() % 65536) & ~3;
+            if (rand() % 3 == 0)
+                fprintf(input_file, "W\t0x%04x\t%d\n", addr, rand() - RAND_MAX / 2);
+            else
+                fprintf(input_file, "R\t0x%04x\n", addr);
+        }
+        fflush(input_file);
+    }
+
+    struct stat st;
+    fstat(fileno(input_file), &st);
+
+    // warm the page cache so both passes read from memory
+    rewind(input_file);
+    unsigned long legacy_sum = 0;
+    legacy_parse(input_file, &legacy_sum);
+
+    rewind(input_file);
+    legacy_sum = 0;
+    double start = now_ns();
+    unsigned long legacy_records = legacy_parse(input_file, &legacy_sum);
+    double legacy_ns = now_ns() - start;
+
+    // the reader takes ownership of the descriptor it is given
+    unsigned long fast_sum = 0;
+    int fd = dup(fileno(input_file));
+    lseek(fd, 0, SEEK_SET);
+    start = now_ns();
+    unsigned long fast_records = fast_parse(fd, &fast_sum);
+    double fast_ns = now_ns() - start;
+    fclose(input_file);
+
+    if (legacy_records != fast_records || legacy_sum != fast_sum)
+    {
+        fprintf(stderr, "Error: The parsers disagree (%lu vs %lu records).\n",
+                legacy_records, fast_records);
+        exit(2);
+    }
+
+    double mb = (double) st.st_size / 1e6;
+    printf("records:\t%lu (%.1lf MB)\n", fast_records, mb);
+    printf("getline+sscanf:\t%.1lf MB/s, %.1lf ns/record\n",
+           mb / (legacy_ns / 1e9), legacy_ns / fast_records);
+    printf("text reader:\t%.1lf MB/s, %.1lf ns/record\n",
+           mb / (fast_ns / 1e9), fast_ns / fast_records);
+    printf("speedup:\t%.1lfx\n", legacy_ns / fast_ns);
+
+    return 0;
+}
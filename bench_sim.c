@@ -0,0 +1,378 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "multi_sim.h"
+
+// Throughput benchmark of the simulator: generates synthetic traces in
+// memory, runs each through sc, dmc, fac and sac with their default
+// geometry, as main --quiet would, and reports accesses per second, time per
+// access and heap allocations per access. Results can be written as CSV and
+// compared against an earlier run to spot regressions.
+//
+// Allocations are counted by wrapping malloc, calloc and realloc at link
+// time (-Wl,--wrap), as the bench target in the Makefile does.
+
+#define BENCH_DEFAULT_ACCESSES 2000000
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_THRESHOLD 10
+
+// Main memory of every run, and the footprint of the traces within it
+#define BENCH_MEM_SIZE (1 << 24)
+
+#define BENCH_STRIDE 256            // bytes between strided accesses
+#define BENCH_ZIPF_BLOCKS 65536     // distinct blocks of the Zipfian trace
+#define BENCH_ZIPF_S 1.0            // its exponent
+#define BENCH_CHASE_NODES 65536     // nodes of the pointer chase
+#define BENCH_CHASE_NODE_SIZE 64
+#define BENCH_SWEEP_PHASES 6        // working sets of 4 KiB to 4 MiB
+#define BENCH_WRITE_EVERY 4         // one access in this many is a store
+
+static unsigned long long num_allocs = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    ++num_allocs;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    ++num_allocs;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    ++num_allocs;
+    return __real_realloc(ptr, size);
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// xorshift64*, so traces are the same on every machine
+static uint64_t next_random(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// Fills in the record for the ith access of a trace, to a word address
+static void set_record(trace_record* r, size_t i, uintptr_t addr)
+{
+    r->addr = (addr % BENCH_MEM_SIZE) & ~(uintptr_t) 3;
+    r->op = i % BENCH_WRITE_EVERY == 0 ? TRACE_WRITE : TRACE_READ;
+    r->val = (uint32_t) i;
+}
+
+static void gen_sequential(trace_record* records, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        set_record(&records[i], i, 4 * i);
+}
+
+static void gen_strided(trace_record* records, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        // shift each pass by a word so passes touch new words
+        uintptr_t pass = i * BENCH_STRIDE / BENCH_MEM_SIZE;
+        set_record(&records[i], i, i * BENCH_STRIDE + 4 * pass);
+    }
+}
+
+static void gen_random(trace_record* records, size_t n)
+{
+    uint64_t state = 1;
+    size_t i;
+    for (i = 0; i < n; i++)
+        set_record(&records[i], i, next_random(&state));
+}
+
+// Block ranks drawn from a Zipf distribution by inverting its CDF, and
+// scattered over memory so hot blocks do not share sets
+static void gen_zipf(trace_record* records, size_t n)
+{
+    double* cdf = malloc(BENCH_ZIPF_BLOCKS * sizeof(double));
+    double sum = 0;
+    unsigned int k;
+    for (k = 0; k < BENCH_ZIPF_BLOCKS; k++)
+    {
+        sum += 1 / pow(k + 1, BENCH_ZIPF_S);
+        cdf[k] = sum;
+    }
+
+    uint64_t state = 2;
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        double u = (double) (next_random(&state) >> 11) / (1ull << 53) * sum;
+        unsigned int lo = 0, hi = BENCH_ZIPF_BLOCKS - 1;
+        while (lo < hi)
+        {
+            unsigned int mid = (lo + hi) / 2;
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        uintptr_t block = (lo * (uintptr_t) 0x9E3779B1u) % BENCH_ZIPF_BLOCKS;
+        uintptr_t word = next_random(&state) % (MAIN_MEMORY_BLOCK_SIZE / 4);
+        set_record(&records[i], i,
+                   block * (BENCH_MEM_SIZE / BENCH_ZIPF_BLOCKS) + 4 * word);
+    }
+    free(cdf);
+}
+
+// Follows a single random cycle through the nodes (Sattolo's algorithm),
+// so every access depends on the one before in a real program
+static void gen_chase(trace_record* records, size_t n)
+{
+    unsigned int* next = malloc(BENCH_CHASE_NODES * sizeof(unsigned int));
+    unsigned int k;
+    for (k = 0; k < BENCH_CHASE_NODES; k++)
+        next[k] = k;
+    uint64_t state = 3;
+    for (k = BENCH_CHASE_NODES - 1; k > 0; k--)
+    {
+        unsigned int j = next_random(&state) % k;
+        unsigned int t = next[k];
+        next[k] = next[j];
+        next[j] = t;
+    }
+
+    unsigned int node = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        set_record(&records[i], i, (uintptr_t) node * BENCH_CHASE_NODE_SIZE);
+        node = next[node];
+    }
+    free(next);
+}
+
+// Phases of sequential passes over a working set that grows fourfold each
+// phase, so the trace sweeps from fitting in the cache to far past it
+static void gen_sweep(trace_record* records, size_t n)
+{
+    size_t phase_len = n / BENCH_SWEEP_PHASES + 1;
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        size_t phase = i / phase_len;
+        uintptr_t working_set = (uintptr_t) 4096 << (2 * phase);
+        set_record(&records[i], i, (4 * (i - phase * phase_len))
+                                   % working_set);
+    }
+}
+
+typedef struct generator
+{
+    const char* name;
+    void (*fill)(trace_record* records, size_t n);
+} generator;
+
+static const generator generators[] = {
+    { "sequential", gen_sequential },
+    { "strided", gen_strided },
+    { "random", gen_random },
+    { "zipf", gen_zipf },
+    { "chase", gen_chase },
+    { "sweep", gen_sweep },
+};
+
+static const char* const mode_names[] = { "sc", "dmc", "fac", "sac" };
+
+#define NUM_GENERATORS (sizeof(generators) / sizeof(generators[0]))
+#define NUM_MODES (sizeof(mode_names) / sizeof(mode_names[0]))
+
+typedef struct bench_result
+{
+    char trace[32];
+    char mode[8];
+    double ns_per_access;
+    double allocs_per_access;
+} bench_result;
+
+// Runs the records through a fresh simulation of cfg, a batch at a time as
+// main does, and fills in the time and allocations per access of the run
+static void run_once(const sim_config* cfg, int image_fd, size_t image_size,
+                     const trace_record* records, size_t n,
+                     double* ns_per_access, double* allocs_per_access)
+{
+    multi_sim* ms = ms_init(cfg, 1, image_fd, image_size, BENCH_MEM_SIZE);
+    ms->sims[0].mm.verbose = 0;
+
+    unsigned long long allocs = num_allocs;
+    double start = now_ns();
+    size_t i;
+    for (i = 0; i < n; i += MULTI_SIM_BATCH)
+        ms_run(ms, records + i, n - i < MULTI_SIM_BATCH ? n - i
+                                                        : MULTI_SIM_BATCH);
+    *ns_per_access = (now_ns() - start) / n;
+    *allocs_per_access = (double) (num_allocs - allocs) / n;
+    ms_free(ms);
+}
+
+// Reads the rows of a CSV written by --output; returns how many
+static unsigned int read_baseline(const char* path, bench_result* rows,
+                                  unsigned int max_rows)
+{
+    FILE* file = fopen(path, "r");
+    if (file == 0)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", path);
+        exit(3);
+    }
+    char line[256];
+    unsigned int result = 0;
+    while (result < max_rows && fgets(line, sizeof(line), file))
+    {
+        bench_result* r = &rows[result];
+        double maccesses;
+        if (sscanf(line, "%31[^,],%7[^,],%lf,%lf,%lf", r->trace, r->mode,
+                   &maccesses, &r->ns_per_access, &r->allocs_per_access) == 5)
+            ++result;
+    }
+    fclose(file);
+    return result;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [--accesses N] [--repeat N] [--output FILE]"
+                    " [--baseline FILE [--threshold PERCENT]]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = BENCH_DEFAULT_ACCESSES;
+    unsigned int repeat = BENCH_DEFAULT_REPEAT;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    const char* output_path = 0;
+    const char* baseline_path = 0;
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (strcmp(argv[i], "--accesses") == 0)
+            n = cfg_parse_count(argv[i], argv[i + 1]);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = cfg_parse_count(argv[i], argv[i + 1]);
+        else if (strcmp(argv[i], "--threshold") == 0)
+            threshold = cfg_parse_count(argv[i], argv[i + 1]);
+        else if (strcmp(argv[i], "--output") == 0)
+            output_path = argv[i + 1];
+        else if (strcmp(argv[i], "--baseline") == 0)
+            baseline_path = argv[i + 1];
+        else
+            usage(argv[0]);
+        ++i;
+    }
+
+    bench_result baseline[NUM_GENERATORS * NUM_MODES];
+    unsigned int num_baseline = 0;
+    if (baseline_path)
+        num_baseline = read_baseline(baseline_path, baseline,
+                                     NUM_GENERATORS * NUM_MODES);
+
+    FILE* output = 0;
+    if (output_path)
+    {
+        output = fopen(output_path, "w");
+        if (output == 0)
+        {
+            fprintf(stderr, "Error: Could not create %s.\n", output_path);
+            exit(3);
+        }
+        fprintf(output, "trace,model,maccesses_per_s,ns_per_access,"
+                        "allocs_per_access\n");
+    }
+
+    size_t image_size;
+    int image_fd = mm_open_image(&image_size);
+    trace_record* records = malloc(n * sizeof(trace_record));
+
+    printf("%zu accesses per trace, best of %u\n", n, repeat);
+    printf("%-12s%-6s%10s%10s%14s%10s\n", "trace", "model", "Macc/s",
+           "ns/acc", "allocs/acc", "change");
+    unsigned int regressions = 0;
+    unsigned int g, m;
+    for (g = 0; g < NUM_GENERATORS; g++)
+    {
+        generators[g].fill(records, n);
+        for (m = 0; m < NUM_MODES; m++)
+        {
+            sim_config cfg;
+            cfg_make(mode_names[m], 0, 0, MAIN_MEMORY_BLOCK_SIZE,
+                     BENCH_MEM_SIZE, 0, &cfg);
+            double best_ns = INFINITY, allocs = 0;
+            unsigned int r;
+            for (r = 0; r < repeat; r++)
+            {
+                double ns;
+                run_once(&cfg, image_fd, image_size, records, n, &ns,
+                         &allocs);
+                if (ns < best_ns)
+                    best_ns = ns;
+            }
+            free(cfg.name);
+
+            printf("%-12s%-6s%10.1lf%10.2lf%14.6lf", generators[g].name,
+                   mode_names[m], 1e3 / best_ns, best_ns, allocs);
+            unsigned int b;
+            for (b = 0; b < num_baseline; b++)
+            {
+                if (strcmp(baseline[b].trace, generators[g].name) == 0
+                    && strcmp(baseline[b].mode, mode_names[m]) == 0)
+                    break;
+            }
+            if (b < num_baseline)
+            {
+                double change = (best_ns / baseline[b].ns_per_access - 1)
+                                * 100;
+                int slower = change > threshold;
+                regressions += slower;
+                printf("%+9.1lf%%%s", change, slower ? "  slower" : "");
+            }
+            printf("\n");
+            if (output)
+                fprintf(output, "%s,%s,%.3lf,%.3lf,%.6lf\n",
+                        generators[g].name, mode_names[m], 1e3 / best_ns,
+                        best_ns, allocs);
+        }
+    }
+
+    free(records);
+    close(image_fd);
+    if (output)
+        fclose(output);
+    if (baseline_path)
+    {
+        printf("%u of %zu runs more than %.0lf%% slower than %s\n",
+               regressions, NUM_GENERATORS * NUM_MODES, threshold,
+               baseline_path);
+        if (regressions)
+            return 1;
+    }
+    return 0;
+}
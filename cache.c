@@ -0,0 +1,900 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cache.h"
+#include "fully_associative.h"
+
+int cache_config_valid(const cache_config* cfg)
+{
+    if (cfg->num_sets == 0 || cfg->num_ways == 0)
+    {
+        fprintf(stderr, "Error: A cache needs at least one set and one way.\n");
+        return 0;
+    }
+    if (cfg->policy && cfg->policy->pow2_ways && !addr_is_pow2(cfg->num_ways))
+    {
+        fprintf(stderr, "Error: The %s policy needs a power-of-two number"
+                        " of ways.\n", cfg->policy->name);
+        return 0;
+    }
+    if (cfg->prefetch && (cfg->pf_degree == 0 || cfg->pf_degree > PF_MAX_DEGREE
+                          || cfg->pf_distance == 0))
+    {
+        fprintf(stderr, "Error: The prefetch degree must be 1 to %d and the"
+                        " distance at least 1.\n", PF_MAX_DEGREE);
+        return 0;
+    }
+    if (cfg->prefetch && cfg->inclusion == CACHE_EXCLUSIVE)
+    {
+        fprintf(stderr, "Error: An exclusive cache cannot prefetch.\n");
+        return 0;
+    }
+    if (cfg->victim_kind == CACHE_VICTIM
+        && (cfg->write_through || !cfg->write_allocate))
+    {
+        fprintf(stderr, "Error: A cache with a victim cache must be"
+                        " write-back, write-allocate.\n");
+        return 0;
+    }
+    if ((unsigned long long) cfg->num_sets * cfg->num_ways > UINT_MAX)
+    {
+        fprintf(stderr, "Error: Too many cache lines (%u sets x %u ways).\n",
+                cfg->num_sets, cfg->num_ways);
+        return 0;
+    }
+    return 1;
+}
+
+cache* cache_init(main_memory* mm, const cache_config* cfg)
+{
+    cache* result = malloc(sizeof(cache));
+    cache_setup(result, mm, cfg);
+    return result;
+}
+
+void cache_setup(cache* result, main_memory* mm, const cache_config* cfg)
+{
+    mem_level below = mm_level(mm);
+    cache_setup_below(result, &below, mm->block_size, cfg);
+    result->pf_limit = mm->size / mm->block_size;
+}
+
+void cache_setup_below(cache* result, const mem_level* below,
+                       size_t block_size, const cache_config* cfg)
+{
+    result->below = *below;
+    result->cs = cs_init();
+    result->num_sets = cfg->num_sets;
+    result->num_ways = cfg->num_ways;
+    addr_layout_init(&result->layout, block_size, cfg->num_sets);
+
+    unsigned int num_lines = cfg->num_sets * cfg->num_ways;
+    ls_init(&result->lines, num_lines, block_size);
+
+    // Policy metadata is padded to 8 bytes per set so sets stay aligned
+    result->policy = cfg->policy ? cfg->policy : &repl_lru;
+    result->repl_stride = (result->policy->meta_size(cfg->num_ways) + 7) & ~(size_t) 7;
+    result->repl_meta = malloc(result->repl_stride * cfg->num_sets);
+    result->rng = 0x2545F4914F6CDD1Dull;
+    result->num_valid = calloc(cfg->num_sets, sizeof(unsigned int));
+    unsigned int i;
+    for(i = 0; i < cfg->num_sets; i++)
+        result->policy->init(result->repl_meta + i * result->repl_stride,
+                             cfg->num_ways);
+
+    result->hash_heads = 0;
+    result->hash_next = 0;
+    result->hash_mask = 0;
+    if (cfg->num_ways >= CACHE_HASH_MIN_WAYS)
+    {
+        // at least two buckets per line keeps chains short
+        uintptr_t num_buckets = 1;
+        while (num_buckets < 2 * (uintptr_t) num_lines)
+            num_buckets <<= 1;
+        result->hash_heads = malloc(num_buckets * sizeof(unsigned int));
+        result->hash_next = malloc(num_lines * sizeof(unsigned int));
+        result->hash_mask = num_buckets - 1;
+        for(i = 0; i < num_buckets; i++)
+            result->hash_heads[i] = CACHE_NONE;
+    }
+
+    result->inclusion = cfg->inclusion;
+    result->above = 0;
+    result->num_above = 0;
+    result->write_through = cfg->write_through;
+    result->write_allocate = cfg->write_allocate;
+
+    result->prefetch = cfg->prefetch;
+    result->pf_state = 0;
+    result->pf_degree = cfg->pf_degree;
+    result->pf_distance = cfg->pf_distance;
+    result->pf_limit = 0;
+    result->prefetched = 0;
+    result->pf_evicted = 0;
+    result->pf_queued = 0;
+    result->pf_ticks = 0;
+    result->pf_inflight = 0;
+    if (cfg->prefetch)
+    {
+        result->pf_state = malloc(cfg->prefetch->state_size());
+        cfg->prefetch->init(result->pf_state);
+        result->prefetched = calloc(num_lines, 1);
+        result->pf_evicted = malloc(num_lines * sizeof(uintptr_t));
+        for (i = 0; i < num_lines; i++)
+            result->pf_evicted[i] = UINTPTR_MAX;
+    }
+    result->extended = cfg->write_through || !cfg->write_allocate
+                       || cfg->prefetch;
+
+    result->profile = 0;
+    result->victim = 0;
+    result->spare_way = 0;
+    if (cfg->victim_entries)
+    {
+        // a fully associative LRU cache between this one and below
+        cache_config victim_cfg = fac_config();
+        victim_cfg.num_ways = cfg->victim_entries;
+        victim_cfg.policy = 0;
+        if (cfg->victim_kind == CACHE_VICTIM)
+        {
+            victim_cfg.inclusion = CACHE_EXCLUSIVE;
+            ++victim_cfg.num_ways;
+        }
+        else
+            victim_cfg.write_allocate = 0;  // evictions go around it
+        result->victim = malloc(sizeof(cache));
+        cache_setup_below(result->victim, below, block_size, &victim_cfg);
+        result->victim->spare_way = cfg->victim_kind == CACHE_VICTIM;
+        result->below = cache_as_level(result->victim);
+    }
+}
+
+// Policy metadata of set
+static inline void* repl_meta(cache* c, unsigned int set)
+{
+    return c->repl_meta + set * c->repl_stride;
+}
+
+// Bucket of block in the tag hash table
+static inline uintptr_t hash_bucket(cache* c, uintptr_t block)
+{
+    // Fibonacci hashing spreads strided block numbers across buckets
+    return (block * (uintptr_t) 0x9E3779B97F4A7C15ull >> 17) & c->hash_mask;
+}
+
+static void hash_insert(cache* c, uintptr_t block, unsigned int line)
+{
+    uintptr_t bucket = hash_bucket(c, block);
+    c->hash_next[line] = c->hash_heads[bucket];
+    c->hash_heads[bucket] = line;
+}
+
+static void hash_remove(cache* c, uintptr_t block, unsigned int line)
+{
+    unsigned int* link = &c->hash_heads[hash_bucket(c, block)];
+    while (*link != line)
+        link = &c->hash_next[*link];
+    *link = c->hash_next[line];
+}
+
+// Returns the way of set holding mb_start_addr, or -1 on miss
+static inline int find_way(cache* c, unsigned int set, uintptr_t block,
+                           void* mb_start_addr)
+{
+    unsigned int base = set * c->num_ways;
+    if (c->hash_heads)
+    {
+        unsigned int line = c->hash_heads[hash_bucket(c, block)];
+        while (line != CACHE_NONE && c->lines.tags[line] != mb_start_addr)
+            line = c->hash_next[line];
+        return line == CACHE_NONE ? -1 : (int) (line - base);
+    }
+
+    return ls_find(&c->lines, base, c->num_ways, mb_start_addr);
+}
+
+// Picks a way of set to replace. Invalid ways are used first, in way order;
+// the policy only chooses among full sets.
+static inline unsigned int choose_victim(cache* c, unsigned int set)
+{
+    // direct-mapped sets do not keep num_valid, since the single-way path
+    // of access_line fills them without it
+    if (c->num_ways == 1)
+        return 0;
+    if (c->num_valid[set] < c->num_ways)
+    {
+        // ways fill up in order unless blocks were invalidated since
+        unsigned int base = set * c->num_ways;
+        unsigned int way = c->num_valid[set]++;
+        if (c->lines.valid[base + way] == 1)
+        {
+            for (way = 0; c->lines.valid[base + way] == 1; way++)
+                ;
+        }
+        return way;
+    }
+    return c->policy->victim(repl_meta(c, set), c->num_ways, &c->rng);
+}
+
+static void hash_remove_line(cache* c, unsigned int line)
+{
+    addr_parts old;
+    addr_split(&c->layout, c->lines.tags[line], c->layout.pow2, &old);
+    hash_remove(c, old.block, line);
+}
+
+// Empties line of set
+static void drop_line(cache* c, unsigned int set, unsigned int line)
+{
+    if (c->hash_heads)
+        hash_remove_line(c, line);
+    ls_invalidate(&c->lines, line);
+    // direct-mapped sets never look at num_valid
+    if (c->num_ways > 1)
+        --c->num_valid[set];
+}
+
+static int invalidate(cache* c, void* start_addr, void* buf);
+
+// Removes the block starting at start_addr from every cache above c. If any
+// of them held it dirty, copies the newest data to buf and returns 1.
+static int invalidate_above(cache* c, void* start_addr, void* buf)
+{
+    int result = 0;
+    unsigned int i;
+    for (i = 0; i < c->num_above; i++)
+        result |= invalidate(c->above[i], start_addr, buf);
+    return result;
+}
+
+// Same as invalidate_above, but for c itself too
+static int invalidate(cache* c, void* start_addr, void* buf)
+{
+    // a victim or miss cache sits between c and the level below
+    int result = c->victim ? invalidate(c->victim, start_addr, buf) : 0;
+    addr_parts p;
+    addr_split(&c->layout, start_addr, c->layout.pow2, &p);
+    int way = find_way(c, p.set, p.block, start_addr);
+    if (way >= 0)
+    {
+        unsigned int line = p.set * c->num_ways + way;
+        if (c->lines.dirty[line] == 1)
+        {
+            memcpy(buf, ls_data(&c->lines, line), c->lines.block_size);
+            result = 1;
+        }
+        drop_line(c, p.set, line);
+    }
+
+    // copies further up are newer
+    return invalidate_above(c, start_addr, buf) | result;
+}
+
+// Evicts way of set and claims it for the block. The block is loaded from
+// below if load is 1; otherwise the caller is about to overwrite all of it.
+static void fill_way(cache* c, unsigned int set, unsigned int way,
+                     addr_parts* p, const int load)
+{
+    unsigned int line = set * c->num_ways + way;
+    if (c->lines.valid[line] == 1)
+    {
+        // keep inclusion: the caches above lose the victim too, and their
+        // dirty copy of it is the one that goes down
+        if (c->inclusion == CACHE_INCLUSIVE
+            && invalidate_above(c, c->lines.tags[line],
+                                ls_data(&c->lines, line)))
+            c->lines.dirty[line] = 1;
+        if (c->hash_heads)
+            hash_remove_line(c, line);
+        if (cache_profiling(c))
+            prof_evict(c->profile, set);
+    }
+    // the line joins the hash table once it holds the block, so lookups
+    // from below in the meantime cannot find it
+    if (load)
+        ls_fill(&c->lines, &c->below, line, p->block_start);
+    else
+        ls_claim(&c->lines, &c->below, line, p->block_start);
+    if (c->hash_heads)
+        hash_insert(c, p->block, line);
+    c->policy->insert(repl_meta(c, set), c->num_ways, way, &c->rng);
+    if (c->prefetched)
+        c->prefetched[line] = 0;
+}
+
+// Same as fill_way, for the way the replacement policy picks, which it
+// returns
+static unsigned int fill(cache* c, unsigned int set, addr_parts* p,
+                         const int load)
+{
+    unsigned int way = choose_victim(c, set);
+    fill_way(c, set, way, p, load);
+    return way;
+}
+
+// Returns the line holding the block of p, filling it from main memory on a
+// miss. pow2 and direct are constants at every call site below, so each
+// combination compiles to its own specialized copy: shift/mask indexing for
+// power-of-two geometries and a single tag compare with no replacement
+// bookkeeping for direct-mapped caches.
+static inline __attribute__((always_inline))
+unsigned int lookup_line(cache* c, addr_parts* p, int* miss,
+                         const int direct)
+{
+    unsigned int base = p->set * c->num_ways;
+    if (direct)
+    {
+        *miss = c->lines.tags[base] != p->block_start;
+        // an inclusive level has to take the victim out of the caches
+        // above, which fill_way does
+        if (*miss && c->inclusion == CACHE_INCLUSIVE)
+            fill_way(c, p->set, 0, p, 1);
+        else if (*miss)
+        {
+            if (cache_profiling(c) && c->lines.valid[base] == 1)
+                prof_evict(c->profile, p->set);
+            ls_fill(&c->lines, &c->below, base, p->block_start);
+        }
+        return base;
+    }
+
+    // Updates cache and memory on miss
+    int way = find_way(c, p->set, p->block, p->block_start);
+    *miss = way < 0;
+    if (way < 0)
+        way = fill(c, p->set, p, 1);
+    else
+        c->policy->touch(repl_meta(c, p->set), c->num_ways, way);
+    return base + way;
+}
+
+// Same as lookup_line, for addr
+static inline __attribute__((always_inline))
+unsigned int access_line(cache* c, void* addr, size_t* addr_offt, int* miss,
+                         const int pow2, const int direct)
+{
+    addr_parts p;
+    addr_split(&c->layout, addr, pow2, &p);
+    *addr_offt = p.offset;
+    return lookup_line(c, &p, miss, direct);
+}
+
+// Slot of block in the pf_evicted table
+static inline uintptr_t pf_slot(cache* c, uintptr_t block)
+{
+    return block % c->lines.num_lines;
+}
+
+static void level_read(void* self, void* start_addr, void* dst, int* dirty);
+
+// Adds delta to pf_inflight of the caches below c
+static void pf_mark_below(cache* c, int delta)
+{
+    while (c->below.read == level_read)
+    {
+        c = c->below.self;
+        c->pf_inflight += delta;
+    }
+}
+
+// Fills the prefetched block number block, unless something brought it in
+// while it was queued
+static void pf_fill(cache* c, uintptr_t block)
+{
+    addr_parts p;
+    void* start_addr = (void*) (MAIN_MEMORY_START_ADDR
+                                + block * c->layout.block_size);
+    addr_split(&c->layout, start_addr, c->layout.pow2, &p);
+    if (find_way(c, p.set, p.block, start_addr) >= 0)
+        return;
+
+    unsigned int way = choose_victim(c, p.set);
+    unsigned int line = p.set * c->num_ways + way;
+    if (c->lines.valid[line] == 1 && !c->prefetched[line])
+    {
+        addr_parts old;
+        addr_split(&c->layout, c->lines.tags[line], c->layout.pow2, &old);
+        c->pf_evicted[pf_slot(c, old.block)] = old.block;
+    }
+    ++c->cs.pf_reads;
+    pf_mark_below(c, 1);
+    fill_way(c, p.set, way, &p, 1);
+    pf_mark_below(c, -1);
+    c->prefetched[line] = 1;
+}
+
+// Fills every queued prefetch, oldest first
+static void pf_fill_queue(cache* c)
+{
+    unsigned int i;
+    for (i = 0; i < c->pf_queued; i++)
+        pf_fill(c, c->pf_queue[i]);
+    c->pf_queued = 0;
+    c->pf_ticks = 0;
+}
+
+// Queues a prefetch of block number block, unless it is past the end of
+// memory, held already or queued already
+static void pf_request(cache* c, uintptr_t block)
+{
+    if (block >= c->pf_limit)
+        return;
+    addr_parts p;
+    void* start_addr = (void*) (MAIN_MEMORY_START_ADDR
+                                + block * c->layout.block_size);
+    addr_split(&c->layout, start_addr, c->layout.pow2, &p);
+    if (find_way(c, p.set, p.block, start_addr) >= 0)
+        return;
+    unsigned int i;
+    for (i = 0; i < c->pf_queued; i++)
+    {
+        if (c->pf_queue[i] == block)
+            return;
+    }
+
+    if (c->pf_queued == CACHE_PF_QUEUE)
+        pf_fill_queue(c);
+    c->pf_queue[c->pf_queued++] = block;
+    ++c->cs.pf_issued;
+}
+
+// Tells the prefetcher about a demand access to addr, which hit or was
+// filled in line, or went around the cache if line is CACHE_NONE, and
+// queues the blocks it asks for
+static void pf_demand(cache* c, void* addr, unsigned int line, int miss)
+{
+    addr_parts p;
+    addr_split(&c->layout, addr, c->layout.pow2, &p);
+    int trigger = miss;
+    if (miss)
+    {
+        if (line != CACHE_NONE)
+            c->prefetched[line] = 0;
+
+        // the queued prefetch of the block did not arrive in time
+        unsigned int i;
+        for (i = 0; i < c->pf_queued; i++)
+        {
+            if (c->pf_queue[i] == p.block)
+            {
+                memmove(c->pf_queue + i, c->pf_queue + i + 1,
+                        (--c->pf_queued - i) * sizeof(uintptr_t));
+                ++c->cs.pf_late;
+                break;
+            }
+        }
+
+        uintptr_t* evicted = &c->pf_evicted[pf_slot(c, p.block)];
+        if (*evicted == p.block)
+        {
+            ++c->cs.pf_polluting;
+            *evicted = UINTPTR_MAX;
+        }
+    }
+    else if (c->prefetched[line])
+    {
+        c->prefetched[line] = 0;
+        ++c->cs.pf_useful;
+        trigger = 1;
+    }
+
+    uintptr_t blocks[PF_MAX_DEGREE];
+    unsigned int n = c->prefetch->observe(c->pf_state, p.block, trigger,
+                                          c->pf_degree, c->pf_distance,
+                                          blocks);
+    unsigned int i;
+    for (i = 0; i < n; i++)
+        pf_request(c, blocks[i]);
+    if (++c->pf_ticks == CACHE_PF_INTERVAL)
+        pf_fill_queue(c);
+}
+
+// Hands a demand access to the profile of c
+static __attribute__((noinline))
+void profile_access(cache* c, void* addr, int miss)
+{
+    addr_parts p;
+    addr_split(&c->layout, addr, c->layout.pow2, &p);
+    prof_access(c->profile, p.set, p.block, miss);
+}
+
+// Demand access of caches that are write-through, no-write-allocate or
+// prefetch. Kept out of line so the default write-back, write-allocate
+// path stays small.
+static __attribute__((noinline))
+unsigned int access_extended(cache* c, void* addr, int write, unsigned int val)
+{
+    unsigned int result = 0;
+    unsigned int line = CACHE_NONE;
+    int miss = 1;
+    if (write)
+        ++c->cs.w_queries;
+    else
+        ++c->cs.r_queries;
+
+    if (write && !c->write_allocate)
+        line = cache_find_line(c, addr);
+    if (write && !c->write_allocate && line == CACHE_NONE)
+    {
+        // write around
+        ++c->cs.w_misses;
+        c->below.write_word(c->below.self, addr, val);
+    }
+    else
+    {
+        size_t addr_offt;
+        line = access_line(c, addr, &addr_offt, &miss, c->layout.pow2,
+                           c->num_ways == 1);
+        unsigned int* mb_addr = ls_data(&c->lines, line) + addr_offt;
+        if (write)
+        {
+            *mb_addr = val;
+            c->cs.w_misses += miss;
+            if (c->write_through)
+                c->below.write_word(c->below.self, addr, val);
+            else
+                c->lines.dirty[line] = 1;
+        }
+        else
+        {
+            result = *mb_addr;
+            c->cs.r_misses += miss;
+        }
+    }
+
+    if (cache_profiling(c))
+        profile_access(c, addr, miss);
+    if (c->prefetch)
+        pf_demand(c, addr, line, miss);
+    return result;
+}
+
+static inline __attribute__((always_inline))
+void store_word(cache* c, void* addr, unsigned int val, const int pow2,
+                const int direct)
+{
+    if (c->extended)
+    {
+        access_extended(c, addr, 1, val);
+        return;
+    }
+
+    size_t addr_offt;
+    int miss;
+    unsigned int line = access_line(c, addr, &addr_offt, &miss, pow2, direct);
+
+    unsigned int* mb_addr = ls_data(&c->lines, line) + addr_offt;
+    *mb_addr = val;
+    c->lines.dirty[line] = 1;
+    if (cache_profiling(c))
+        profile_access(c, addr, miss);
+
+    c->cs.w_misses += miss;
+    ++c->cs.w_queries;
+}
+
+static inline __attribute__((always_inline))
+unsigned int load_word(cache* c, void* addr, const int pow2, const int direct)
+{
+    if (c->extended)
+        return access_extended(c, addr, 0, 0);
+
+    size_t addr_offt;
+    int miss;
+    unsigned int line = access_line(c, addr, &addr_offt, &miss, pow2, direct);
+
+    unsigned int* mb_addr = ls_data(&c->lines, line) + addr_offt;
+    if (cache_profiling(c))
+        profile_access(c, addr, miss);
+
+    c->cs.r_misses += miss;
+    ++c->cs.r_queries;
+    return *mb_addr;
+}
+
+void cache_store_word(cache* c, void* addr, unsigned int val)
+{
+    if (c->layout.pow2)
+    {
+        if (c->num_ways == 1)
+            store_word(c, addr, val, 1, 1);
+        else
+            store_word(c, addr, val, 1, 0);
+    }
+    else
+        store_word(c, addr, val, 0, c->num_ways == 1);
+}
+
+unsigned int cache_load_word(cache* c, void* addr)
+{
+    if (c->layout.pow2)
+    {
+        if (c->num_ways == 1)
+            return load_word(c, addr, 1, 1);
+        return load_word(c, addr, 1, 0);
+    }
+    return load_word(c, addr, 0, c->num_ways == 1);
+}
+
+// Runs records through c as store_word and load_word would, a chunk of
+// CACHE_BATCH at a time. The addresses of a chunk are split up front, in a
+// loop over local arrays the compiler can vectorize, and the lookup of each
+// record prefetches the set CACHE_BATCH_AHEAD records on. The counters are
+// summed in locals and added to cs once per call.
+static inline __attribute__((always_inline))
+void access_batch(cache* c, const trace_record* records, size_t num_records,
+                  unsigned int* vals, const int pow2, const int direct)
+{
+    size_t offsets[CACHE_BATCH];
+    uintptr_t blocks[CACHE_BATCH];
+    unsigned int sets[CACHE_BATCH];
+    const unsigned int offset_bits = c->layout.offset_bits;
+    const uintptr_t index_mask = c->layout.index_mask;
+    const size_t block_size = c->layout.block_size;
+    const unsigned int num_sets = c->layout.num_sets;
+    unsigned int w_queries = 0, r_queries = 0;
+    unsigned int w_misses = 0, r_misses = 0;
+
+    size_t start;
+    for (start = 0; start < num_records; start += CACHE_BATCH)
+    {
+        const trace_record* r = records + start;
+        unsigned int n = num_records - start < CACHE_BATCH
+                         ? num_records - start : CACHE_BATCH;
+        unsigned int i;
+        for (i = 0; i < n; i++)
+        {
+            uintptr_t raw = r[i].addr - MAIN_MEMORY_START_ADDR;
+            if (pow2)
+            {
+                blocks[i] = raw >> offset_bits;
+                offsets[i] = raw - (blocks[i] << offset_bits);
+                sets[i] = blocks[i] & index_mask;
+            }
+            else
+            {
+                blocks[i] = raw / block_size;
+                offsets[i] = raw - blocks[i] * block_size;
+                sets[i] = blocks[i] % num_sets;
+            }
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (i + CACHE_BATCH_AHEAD < n)
+            {
+                unsigned int ahead = i + CACHE_BATCH_AHEAD;
+                if (c->hash_heads)
+                    __builtin_prefetch(&c->hash_heads[
+                        hash_bucket(c, blocks[ahead])]);
+                else
+                    __builtin_prefetch(&c->lines.tags[sets[ahead]
+                                                      * c->num_ways]);
+                if (!direct)
+                    __builtin_prefetch(repl_meta(c, sets[ahead]));
+            }
+
+            void* addr = (void*) r[i].addr;
+            addr_parts p;
+            p.offset = offsets[i];
+            p.block_start = addr - offsets[i];
+            p.block = blocks[i];
+            p.set = sets[i];
+            int miss;
+            unsigned int line = lookup_line(c, &p, &miss, direct);
+            unsigned int* mb_addr = ls_data(&c->lines, line) + p.offset;
+            if (r[i].op == TRACE_WRITE)
+            {
+                *mb_addr = r[i].val;
+                c->lines.dirty[line] = 1;
+                w_misses += miss;
+                ++w_queries;
+            }
+            else
+            {
+                if (vals)
+                    vals[start + i] = *mb_addr;
+                r_misses += miss;
+                ++r_queries;
+            }
+            if (cache_profiling(c))
+                profile_access(c, addr, miss);
+        }
+    }
+
+    c->cs.w_queries += w_queries;
+    c->cs.r_queries += r_queries;
+    c->cs.w_misses += w_misses;
+    c->cs.r_misses += r_misses;
+}
+
+void cache_access_batch(cache* c, const trace_record* records,
+                        size_t num_records, unsigned int* vals)
+{
+    if (c->extended)
+    {
+        size_t i;
+        for (i = 0; i < num_records; i++)
+        {
+            void* addr = (void*) records[i].addr;
+            if (records[i].op == TRACE_WRITE)
+                access_extended(c, addr, 1, records[i].val);
+            else if (vals)
+                vals[i] = access_extended(c, addr, 0, 0);
+            else
+                access_extended(c, addr, 0, 0);
+        }
+        return;
+    }
+
+    if (c->layout.pow2)
+    {
+        if (c->num_ways == 1)
+            access_batch(c, records, num_records, vals, 1, 1);
+        else
+            access_batch(c, records, num_records, vals, 1, 0);
+    }
+    else if (c->num_ways == 1)
+        access_batch(c, records, num_records, vals, 0, 1);
+    else
+        access_batch(c, records, num_records, vals, 0, 0);
+}
+
+// Evicts the least recently used block of a victim cache whose spare way is
+// in use, to bring it back to its entries
+static void trim_spare(cache* c)
+{
+    if (c->num_valid[0] < c->num_ways)
+        return;
+    unsigned int way = c->policy->victim(repl_meta(c, 0), c->num_ways,
+                                         &c->rng);
+    ls_evict(&c->lines, &c->below, way);
+    drop_line(c, 0, way);
+}
+
+// Reads a block for the cache above: c as a mem_level
+static void level_read(void* self, void* start_addr, void* dst, int* dirty)
+{
+    cache* c = self;
+    addr_parts p;
+    addr_split(&c->layout, start_addr, c->layout.pow2, &p);
+    ++c->cs.r_queries;
+    unsigned int misses = c->cs.r_misses;
+    int way = find_way(c, p.set, p.block, start_addr);
+    if (way < 0)
+    {
+        ++c->cs.r_misses;
+        if (c->pf_inflight)
+            ++c->cs.pf_reads;
+        // an exclusive cache only takes blocks evicted from above
+        if (c->inclusion == CACHE_EXCLUSIVE)
+        {
+            if (c->spare_way)
+                trim_spare(c);
+            c->below.read(c->below.self, start_addr, dst, dirty);
+            return;
+        }
+        way = fill(c, p.set, &p, 1);
+    }
+    else
+        c->policy->touch(repl_meta(c, p.set), c->num_ways, way);
+
+    unsigned int line = p.set * c->num_ways + way;
+    memcpy(dst, ls_data(&c->lines, line), c->lines.block_size);
+    *dirty = 0;
+    if (c->prefetch)
+        pf_demand(c, start_addr, line, c->cs.r_misses != misses);
+    if (c->inclusion == CACHE_EXCLUSIVE)
+    {
+        // the block moves up, dirty or not
+        *dirty = c->lines.dirty[line];
+        drop_line(c, p.set, line);
+    }
+}
+
+// Takes a block evicted from the cache above
+static void level_write(void* self, void* start_addr, const void* src,
+                        int dirty)
+{
+    cache* c = self;
+    addr_parts p;
+    addr_split(&c->layout, start_addr, c->layout.pow2, &p);
+    ++c->cs.w_queries;
+    if (c->spare_way)
+        trim_spare(c);
+    int way = find_way(c, p.set, p.block, start_addr);
+    if (way < 0)
+    {
+        ++c->cs.w_misses;
+        if (!c->write_allocate)
+        {
+            // write around; clean blocks only matter to an exclusive
+            // level, which is below a miss cache at most
+            if (dirty || c->below.takes_clean)
+                c->below.write(c->below.self, start_addr, src, dirty);
+            return;
+        }
+        way = fill(c, p.set, &p, 0);
+    }
+    else
+        c->policy->touch(repl_meta(c, p.set), c->num_ways, way);
+
+    unsigned int line = p.set * c->num_ways + way;
+    memcpy(ls_data(&c->lines, line), src, c->lines.block_size);
+    if (c->write_through)
+    {
+        if (dirty)
+            c->below.write(c->below.self, start_addr, src, dirty);
+    }
+    else
+        c->lines.dirty[line] |= dirty;
+}
+
+// Takes a word stored through or around the cache above
+static void level_write_word(void* self, void* addr, unsigned int val)
+{
+    cache_store_word(self, addr, val);
+}
+
+mem_level cache_as_level(cache* c)
+{
+    mem_level result = { c, level_read, level_write, level_write_word,
+                         c->inclusion == CACHE_EXCLUSIVE };
+    return result;
+}
+
+void cache_link(cache* upper, cache* c)
+{
+    if (upper->victim)
+        upper->victim->below = cache_as_level(c);
+    else
+        upper->below = cache_as_level(c);
+    c->above = realloc(c->above, (c->num_above + 1) * sizeof(cache*));
+    c->above[c->num_above++] = upper;
+}
+
+unsigned int cache_find_line(cache* c, void* addr)
+{
+    addr_parts p;
+    addr_split(&c->layout, addr, c->layout.pow2, &p);
+    int way = find_way(c, p.set, p.block, p.block_start);
+    return way < 0 ? CACHE_NONE : p.set * c->num_ways + way;
+}
+
+int cache_invalidate(cache* c, void* start_addr, void* buf)
+{
+    return invalidate(c, start_addr, buf);
+}
+
+void cache_flush(cache* c)
+{
+    ls_flush(&c->lines, &c->below);
+    if (c->victim)
+        cache_flush(c->victim);
+}
+
+// Free all allocated memory
+void cache_release(cache* c)
+{
+    ls_free(&c->lines);
+    free(c->repl_meta);
+    free(c->num_valid);
+    free(c->hash_heads);
+    free(c->hash_next);
+    free(c->above);
+    free(c->pf_state);
+    free(c->prefetched);
+    free(c->pf_evicted);
+    if (c->victim)
+        cache_free(c->victim);
+    if (c->profile)
+        prof_free(c->profile);
+}
+
+void cache_free(cache* c)
+{
+    cache_release(c);
+    free(c);
+}
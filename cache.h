@@ -0,0 +1,201 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <limits.h>
+
+#include "main_memory.h"
+#include "cache_stats.h"
+#include "address.h"
+#include "line_store.h"
+#include "replacement.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "trace.h"
+
+// Sets with at least this many ways find tags through a hash table instead
+// of scanning the set
+#define CACHE_HASH_MIN_WAYS 16
+
+// Marks the end of a hash chain
+#define CACHE_NONE UINT_MAX
+
+// Small fully associative buffers a cache can have right below it
+#define CACHE_VICTIM 1      // takes the blocks the cache evicts, clean or
+                            // dirty; a hit swaps the block with the one
+                            // the cache evicts for it
+#define CACHE_MISS_CACHE 2  // keeps a copy of every block the cache reads
+                            // from below
+
+// Prefetch requests wait in a queue of CACHE_PF_QUEUE blocks and are filled
+// together every CACHE_PF_INTERVAL demand accesses, or when it is full.
+// Demand misses on queued blocks count as late prefetches.
+#define CACHE_PF_QUEUE 64
+#define CACHE_PF_INTERVAL 4
+
+// cache_access_batch splits the addresses of CACHE_BATCH records at a time,
+// and prefetches the set of the record CACHE_BATCH_AHEAD records on
+#define CACHE_BATCH 64
+#define CACHE_BATCH_AHEAD 8
+
+// How a cache relates to the caches directly above it in a hierarchy
+#define CACHE_NINE 0        // holds their blocks or not, independently
+#define CACHE_INCLUSIVE 1   // holds every block they hold; evicting one
+                            // invalidates it above
+#define CACHE_EXCLUSIVE 2   // holds none of their blocks; filled only by
+                            // their evictions, and hands blocks up on a hit
+
+// Geometry, replacement, inclusion, write policy and prefetcher of a cache.
+// The block size is taken from main memory and is the same at every level.
+typedef struct cache_config
+{
+    unsigned int num_sets;
+    unsigned int num_ways;
+    const replacement_policy* policy;   // 0 means LRU
+    int inclusion;                      // CACHE_NINE by default
+    int write_through;                  // 0 (write-back) by default
+    int write_allocate;                 // 1 by default
+    const prefetcher* prefetch;         // 0 means none
+    unsigned int pf_degree;             // blocks asked for at a time, 1
+    unsigned int pf_distance;           // blocks ahead, 1 by default
+    int victim_kind;                    // CACHE_VICTIM or CACHE_MISS_CACHE
+    unsigned int victim_entries;        // 0 means no such buffer
+} cache_config;
+
+// Generic num_sets x num_ways cache. The direct-mapped (num_ways == 1) and
+// fully associative (num_sets == 1) caches are instances of it. Any cache
+// can sit below others: cs then counts the block reads and write-backs that
+// reach it from above, and the words stored through or around them.
+//
+// By default it is write-back and write-allocate. A write-through cache
+// also passes every stored word down and keeps its lines clean; a
+// no-write-allocate cache passes store misses down without filling a line.
+// A prefetcher sees the demand accesses, the word accesses and the block
+// reads from above, and fills the blocks it asks for through the same path
+// as misses. A victim or miss cache is a fully associative cache of its own
+// between the cache and the level below.
+typedef struct cache
+{
+    mem_level below;        // main memory, or the next cache down
+    cache_stats cs;
+    unsigned int num_sets;
+    unsigned int num_ways;
+    addr_layout layout;
+    // line (set * num_ways + way) holds way of set
+    line_store lines;
+
+    // Replacement state: repl_stride bytes of policy metadata per set,
+    // laid out contiguously, and the number of valid ways in each set
+    const replacement_policy* policy;
+    unsigned char* repl_meta;
+    size_t repl_stride;
+    uint64_t rng;
+    unsigned int* num_valid;
+
+    // Hash table from block number to line, chained through hash_next.
+    // Only allocated when num_ways >= CACHE_HASH_MIN_WAYS.
+    unsigned int* hash_heads;
+    unsigned int* hash_next;
+    uintptr_t hash_mask;
+
+    // Caches directly above. An inclusive cache back-invalidates the blocks
+    // it evicts in all of them and the caches above those.
+    int inclusion;
+    struct cache** above;
+    unsigned int num_above;
+
+    int write_through;
+    int write_allocate;
+
+    // Prefetching, off when prefetch is 0. prefetched marks the lines filled
+    // by a prefetch and not used since. pf_evicted remembers, by hash, the
+    // blocks that prefetches evicted, to catch them being missed on later.
+    const prefetcher* prefetch;
+    void* pf_state;
+    unsigned int pf_degree;
+    unsigned int pf_distance;
+    uintptr_t pf_limit;         // blocks below; none past it are fetched
+    unsigned char* prefetched;
+    uintptr_t* pf_evicted;
+    uintptr_t pf_queue[CACHE_PF_QUEUE];
+    unsigned int pf_queued;
+    unsigned int pf_ticks;      // demand accesses since the last fill
+    unsigned int pf_inflight;   // prefetch fills from above being served
+
+    // Victim or miss cache right below, owned by this cache, or 0. A
+    // victim cache has one spare way, which only holds the block evicted
+    // from above until the read that follows the eviction, so that a hit
+    // swaps the two blocks instead of making room first.
+    struct cache* victim;
+    int spare_way;
+
+    // 1 when accesses take the out-of-line path, for a write policy other
+    // than write-back, write-allocate or for prefetching
+    int extended;
+
+    // Profile of the demand accesses, owned by the cache, or 0
+    cache_profile* profile;
+} cache;
+
+// -DCACHE_SIM_PROFILE compiles in the hooks that feed profile; without it
+// they compile away and profile is never looked at.
+#ifdef CACHE_SIM_PROFILE
+#define cache_profiling(c) ((c)->profile != 0)
+#else
+#define cache_profiling(c) 0
+#endif
+
+// Returns 0 and prints an error if cfg is not a cache that can be simulated.
+// The block and memory sizes are checked by cfg_make.
+int cache_config_valid(const cache_config* cfg);
+
+cache* cache_init(main_memory* mm, const cache_config* cfg);
+
+// Same as cache_init, but in caller-owned storage; undone by cache_release
+void cache_setup(cache* c, main_memory* mm, const cache_config* cfg);
+
+// Same as cache_setup, but on top of an arbitrary level with blocks of
+// block_size bytes
+void cache_setup_below(cache* c, const mem_level* below, size_t block_size,
+                       const cache_config* cfg);
+
+// Puts upper directly above c: upper's misses and evictions go to c, and c
+// back-invalidates upper if it is inclusive
+void cache_link(cache* upper, cache* c);
+
+// c as the level below something other than a cache, which c does not
+// back-invalidate
+mem_level cache_as_level(cache* c);
+
+// Returns the line holding addr, or CACHE_NONE, without touching any state
+unsigned int cache_find_line(cache* c, void* addr);
+
+// Drops the block starting at start_addr from c and the caches above it
+// without writing it back. If any of them held it dirty, copies the newest
+// data to buf and returns 1.
+int cache_invalidate(cache* c, void* start_addr, void* buf);
+
+void cache_store_word(cache* c, void* addr, unsigned int val);
+
+unsigned int cache_load_word(cache* c, void* addr);
+
+// Runs num_records accesses through c, with the same results as storing or
+// loading them one at a time. The words loaded go to vals, indexed like
+// records, unless vals is 0.
+void cache_access_batch(cache* c, const trace_record* records,
+                        size_t num_records, unsigned int* vals);
+
+// Block reads c sends below it for prefetches. Those of a cache with a
+// victim or miss cache are the ones that cache missed.
+static inline unsigned int cache_pf_reads_below(const cache* c)
+{
+    return c->victim ? c->victim->cs.pf_reads : c->cs.pf_reads;
+}
+
+// Writes every dirty line down a level, leaving the lines valid
+void cache_flush(cache* c);
+
+void cache_release(cache* c);
+
+void cache_free(cache* c);
+
+#endif
@@ -7,6 +7,21 @@ typedef struct cache_stats
     unsigned int r_queries;
     unsigned int w_misses;
     unsigned int r_misses;
+
+    // Coherence events of a core's private cache in multicore runs
+    unsigned int upgrades;          // write hits that had to invalidate
+                                    // other copies first
+    unsigned int invalidations;     // lines lost to other cores' writes
+    unsigned int coherence_misses;  // misses on blocks lost that way
+
+    // Prefetches of a cache with a prefetcher
+    unsigned int pf_issued;         // blocks asked for and queued
+    unsigned int pf_useful;         // prefetched blocks used before eviction
+    unsigned int pf_late;           // demand misses on blocks still queued
+    unsigned int pf_polluting;      // demand misses on blocks evicted by
+                                    // prefetches
+    unsigned int pf_reads;          // block reads from below for prefetches,
+                                    // this cache's or those of caches above
 } cache_stats;
 
 cache_stats cs_init();
@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "coherence.h"
+
+// Initial directory slots
+#define COH_MIN_TABLE 1024
+
+int coh_find_protocol(const char* name)
+{
+    if (strcmp(name, "mesi") == 0)
+        return COH_MESI;
+    if (strcmp(name, "moesi") == 0)
+        return COH_MOESI;
+    return -1;
+}
+
+static void dir_init(coh_directory* dir, unsigned int num_cores)
+{
+    dir->cap = COH_MIN_TABLE;
+    dir->used = 0;
+    dir->num_words = (num_cores + 63) / 64;
+    dir->keys = calloc(dir->cap, sizeof(uintptr_t));
+    dir->owners = malloc(dir->cap * sizeof(int));
+    dir->bits = malloc(dir->cap * 2 * dir->num_words * sizeof(uint64_t));
+}
+
+// Slot of block: either its entry or the empty slot for it
+static inline size_t dir_slot(const coh_directory* dir, uintptr_t block)
+{
+    uintptr_t key = block + 1;
+    size_t i = (key * (uintptr_t) 0x9E3779B97F4A7C15ull >> 17)
+               & (dir->cap - 1);
+    while (dir->keys[i] != 0 && dir->keys[i] != key)
+        i = (i + 1) & (dir->cap - 1);
+    return i;
+}
+
+static void dir_grow(coh_directory* dir)
+{
+    uintptr_t* old_keys = dir->keys;
+    int* old_owners = dir->owners;
+    uint64_t* old_bits = dir->bits;
+    size_t old_cap = dir->cap;
+    size_t entry_words = 2 * dir->num_words;
+
+    dir->cap *= 2;
+    dir->keys = calloc(dir->cap, sizeof(uintptr_t));
+    dir->owners = malloc(dir->cap * sizeof(int));
+    dir->bits = malloc(dir->cap * entry_words * sizeof(uint64_t));
+    size_t i;
+    for (i = 0; i < old_cap; i++)
+    {
+        if (old_keys[i] == 0)
+            continue;
+        size_t slot = dir_slot(dir, old_keys[i] - 1);
+        dir->keys[slot] = old_keys[i];
+        dir->owners[slot] = old_owners[i];
+        memcpy(dir->bits + slot * entry_words, old_bits + i * entry_words,
+               entry_words * sizeof(uint64_t));
+    }
+    free(old_keys);
+    free(old_owners);
+    free(old_bits);
+}
+
+// Returns the slot of block, adding an entry held by nobody if it has none
+static size_t dir_entry(coh_directory* dir, uintptr_t block)
+{
+    size_t slot = dir_slot(dir, block);
+    if (dir->keys[slot] != 0)
+        return slot;
+    if (2 * (dir->used + 1) > dir->cap)
+    {
+        dir_grow(dir);
+        slot = dir_slot(dir, block);
+    }
+    dir->keys[slot] = block + 1;
+    dir->owners[slot] = -1;
+    memset(dir->bits + slot * 2 * dir->num_words, 0,
+           2 * dir->num_words * sizeof(uint64_t));
+    ++dir->used;
+    return slot;
+}
+
+static inline uint64_t* dir_sharers(coh_directory* dir, size_t slot)
+{
+    return dir->bits + slot * 2 * dir->num_words;
+}
+
+static inline uint64_t* dir_lost(coh_directory* dir, size_t slot)
+{
+    return dir_sharers(dir, slot) + dir->num_words;
+}
+
+static inline int bit_test(const uint64_t* bits, unsigned int i)
+{
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void bit_set(uint64_t* bits, unsigned int i)
+{
+    bits[i / 64] |= (uint64_t) 1 << (i % 64);
+}
+
+static inline void bit_clear(uint64_t* bits, unsigned int i)
+{
+    bits[i / 64] &= ~((uint64_t) 1 << (i % 64));
+}
+
+static inline uintptr_t block_of(const coh_core* core, void* addr)
+{
+    addr_parts p;
+    addr_split(&core->l1.layout, addr, core->l1.layout.pow2, &p);
+    return p.block;
+}
+
+// Invalidates the block in every sharer but core, marking them as having
+// lost it. If one of them held it dirty, copies its data to buf and returns
+// 1. Leaves core as the only sharer.
+static int invalidate_others(coh_system* sys, coh_core* core, size_t slot,
+                             void* start_addr, void* buf)
+{
+    int result = 0;
+    uint64_t* sharers = dir_sharers(&sys->dir, slot);
+    uint64_t* lost = dir_lost(&sys->dir, slot);
+    unsigned int w;
+    for (w = 0; w < sys->dir.num_words; w++)
+    {
+        uint64_t others = sharers[w];
+        while (others)
+        {
+            unsigned int id = w * 64 + __builtin_ctzll(others);
+            others &= others - 1;
+            if (id == core->id)
+                continue;
+            coh_core* peer = &sys->cores[id];
+            result |= cache_invalidate(&peer->l1, start_addr, buf);
+            ++peer->l1.cs.invalidations;
+            bit_set(lost, id);
+        }
+        sharers[w] = 0;
+    }
+    bit_set(sharers, core->id);
+    sys->dir.owners[slot] = core->id;
+    return result;
+}
+
+// A miss of core: fetches the block for a load (shared) or a store
+// (exclusive) and records the state it comes in with
+static void port_read(void* self, void* start_addr, void* dst, int* dirty)
+{
+    coh_core* core = self;
+    coh_system* sys = core->sys;
+    size_t slot = dir_entry(&sys->dir, block_of(core, start_addr));
+    uint64_t* lost = dir_lost(&sys->dir, slot);
+    if (bit_test(lost, core->id))
+    {
+        ++core->l1.cs.coherence_misses;
+        bit_clear(lost, core->id);
+    }
+
+    if (core->write)
+    {
+        // a dirty copy elsewhere comes along with the ownership
+        if (invalidate_others(sys, core, slot, start_addr, dst))
+            *dirty = 1;
+        else
+            sys->shared.read(sys->shared.self, start_addr, dst, dirty);
+        core->fill_state = COH_M;
+        return;
+    }
+
+    uint64_t* sharers = dir_sharers(&sys->dir, slot);
+    int* owner = &sys->dir.owners[slot];
+    *dirty = 0;
+    if (*owner < 0)
+    {
+        unsigned int w;
+        int alone = 1;
+        for (w = 0; w < sys->dir.num_words; w++)
+            alone &= sharers[w] == 0;
+        sys->shared.read(sys->shared.self, start_addr, dst, dirty);
+        core->fill_state = alone ? COH_E : COH_S;
+        if (alone)
+            *owner = core->id;
+    }
+    else
+    {
+        coh_core* peer = &sys->cores[*owner];
+        unsigned int line = cache_find_line(&peer->l1, start_addr);
+        unsigned char* state = &peer->state[line];
+        if (*state == COH_E)
+        {
+            sys->shared.read(sys->shared.self, start_addr, dst, dirty);
+            *state = COH_S;
+            *owner = -1;
+        }
+        else
+        {
+            // the owner supplies the data; under MESI it also writes the
+            // block back and gives up ownership, under MOESI it keeps the
+            // dirty block as its owner
+            void* data = ls_data(&peer->l1.lines, line);
+            memcpy(dst, data, peer->l1.lines.block_size);
+            if (sys->protocol == COH_MOESI)
+                *state = COH_O;
+            else
+            {
+                sys->shared.write(sys->shared.self, start_addr, data, 1);
+                peer->l1.lines.dirty[line] = 0;
+                *state = COH_S;
+                *owner = -1;
+            }
+        }
+        core->fill_state = COH_S;
+    }
+    bit_set(sharers, core->id);
+}
+
+// An eviction of core. Every block is reported, clean or not, so the
+// directory always knows who holds what.
+static void port_write(void* self, void* start_addr, const void* src,
+                       int dirty)
+{
+    coh_core* core = self;
+    coh_system* sys = core->sys;
+    size_t slot = dir_entry(&sys->dir, block_of(core, start_addr));
+    bit_clear(dir_sharers(&sys->dir, slot), core->id);
+    if (sys->dir.owners[slot] == (int) core->id)
+        sys->dir.owners[slot] = -1;
+    if (dirty)
+        sys->shared.write(sys->shared.self, start_addr, src, 1);
+}
+
+coh_system* coh_init(int protocol, unsigned int num_cores,
+                     const cache_config* cfg, size_t block_size,
+                     const mem_level* shared)
+{
+    coh_system* result = malloc(sizeof(coh_system));
+    result->protocol = protocol;
+    result->num_cores = num_cores;
+    result->cores = malloc(num_cores * sizeof(coh_core));
+    result->shared = *shared;
+    dir_init(&result->dir, num_cores);
+    result->scratch = malloc(block_size);
+
+    unsigned int i;
+    for (i = 0; i < num_cores; i++)
+    {
+        coh_core* core = &result->cores[i];
+        // the private caches are write-back, write-allocate, so no single
+        // words go down through the port
+        mem_level port = { core, port_read, port_write, 0, 1 };
+        cache_setup_below(&core->l1, &port, block_size, cfg);
+        core->state = calloc(cfg->num_sets * cfg->num_ways, 1);
+        core->sys = result;
+        core->id = i;
+        core->write = 0;
+        core->fill_state = COH_I;
+    }
+    return result;
+}
+
+void coh_store_word(coh_system* sys, unsigned int id, void* addr,
+                    unsigned int val)
+{
+    coh_core* core = &sys->cores[id];
+    unsigned int line = cache_find_line(&core->l1, addr);
+    if (line == CACHE_NONE)
+    {
+        core->write = 1;
+        cache_store_word(&core->l1, addr, val);
+        core->state[cache_find_line(&core->l1, addr)] = core->fill_state;
+        return;
+    }
+
+    // writing a shared block takes invalidating the other copies first
+    unsigned char* state = &core->state[line];
+    if (*state == COH_S || *state == COH_O)
+    {
+        void* start_addr = addr_block_start(&core->l1.layout, addr);
+        size_t slot = dir_entry(&sys->dir, block_of(core, addr));
+        invalidate_others(sys, core, slot, start_addr, sys->scratch);
+        ++core->l1.cs.upgrades;
+    }
+    *state = COH_M;
+    cache_store_word(&core->l1, addr, val);
+}
+
+unsigned int coh_load_word(coh_system* sys, unsigned int id, void* addr)
+{
+    coh_core* core = &sys->cores[id];
+    unsigned int misses = core->l1.cs.r_misses;
+    core->write = 0;
+    unsigned int result = cache_load_word(&core->l1, addr);
+    if (core->l1.cs.r_misses != misses)
+        core->state[cache_find_line(&core->l1, addr)] = core->fill_state;
+    return result;
+}
+
+int coh_try_local(coh_system* sys, unsigned int id, void* addr, int write,
+                  unsigned int* val)
+{
+    coh_core* core = &sys->cores[id];
+    unsigned int line = cache_find_line(&core->l1, addr);
+    if (line == CACHE_NONE)
+        return 0;
+    if (!write)
+    {
+        *val = cache_load_word(&core->l1, addr);
+        return 1;
+    }
+    unsigned char* state = &core->state[line];
+    if (*state != COH_E && *state != COH_M)
+        return 0;
+    *state = COH_M;
+    cache_store_word(&core->l1, addr, *val);
+    return 1;
+}
+
+void coh_flush(coh_system* sys)
+{
+    unsigned int i;
+    for (i = 0; i < sys->num_cores; i++)
+        cache_flush(&sys->cores[i].l1);
+}
+
+void coh_free(coh_system* sys)
+{
+    unsigned int i;
+    for (i = 0; i < sys->num_cores; i++)
+    {
+        cache_release(&sys->cores[i].l1);
+        free(sys->cores[i].state);
+    }
+    free(sys->cores);
+    free(sys->dir.keys);
+    free(sys->dir.owners);
+    free(sys->dir.bits);
+    free(sys->scratch);
+    free(sys);
+}
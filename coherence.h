@@ -0,0 +1,88 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stdint.h>
+
+#include "cache.h"
+
+// Protocols
+#define COH_MESI 0
+#define COH_MOESI 1
+
+// States of a line in a private cache
+#define COH_I 0
+#define COH_S 1
+#define COH_E 2
+#define COH_O 3
+#define COH_M 4
+
+// Directory of the blocks held in any private cache: an open-addressing
+// table from block number + 1 to the bit vector of the cores holding the
+// block, the bit vector of the cores that lost it to another core's write
+// since they last had it, and the core owning it (in E, O or M) or -1.
+typedef struct coh_directory
+{
+    size_t cap;             // slots, a power of two
+    size_t used;
+    unsigned int num_words; // 64-bit words per bit vector
+    uintptr_t* keys;        // 0 for empty slots
+    int* owners;
+    uint64_t* bits;         // per slot: the sharers, then the lost cores
+} coh_directory;
+
+struct coh_system;
+
+// One core: its private cache, the coherence state of each line, and the
+// access in flight, which the cache's misses and evictions reach through
+// the core's mem_level port
+typedef struct coh_core
+{
+    cache l1;
+    unsigned char* state;
+    struct coh_system* sys;
+    unsigned int id;
+    int write;              // the access in flight is a store
+    int fill_state;         // state the block it fills comes in with
+} coh_core;
+
+// Private caches kept coherent over a shared level by a directory. Accesses
+// run one at a time, so every transaction completes before the next.
+typedef struct coh_system
+{
+    int protocol;
+    unsigned int num_cores;
+    coh_core* cores;
+    mem_level shared;       // main memory or a shared cache
+    coh_directory dir;
+    unsigned char* scratch; // one block, for copies nobody needs
+} coh_system;
+
+// Returns the protocol called name, or -1
+int coh_find_protocol(const char* name);
+
+// Sets up num_cores cores with a private cfg cache each over shared, which
+// holds blocks of block_size bytes. A shared cache must be non-inclusive,
+// non-exclusive: the directory has to see every block leave a core. cfg must
+// be write-back, write-allocate, since stores only take ownership of blocks.
+coh_system* coh_init(int protocol, unsigned int num_cores,
+                     const cache_config* cfg, size_t block_size,
+                     const mem_level* shared);
+
+void coh_store_word(coh_system* sys, unsigned int core, void* addr,
+                    unsigned int val);
+
+unsigned int coh_load_word(coh_system* sys, unsigned int core, void* addr);
+
+// Runs the access of core if it hits with the permission it needs, which
+// touches nothing but the core's own cache, and returns 1. Returns 0 and
+// leaves everything as it was if the access needs the directory. Loads
+// return the value read in *val.
+int coh_try_local(coh_system* sys, unsigned int core, void* addr, int write,
+                  unsigned int* val);
+
+// Writes every dirty line of every core down to the shared level
+void coh_flush(coh_system* sys);
+
+void coh_free(coh_system* sys);
+
+#endif
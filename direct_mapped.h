@@ -1,25 +1,25 @@
 #ifndef DIRECT_MAPPED_H
 #define DIRECT_MAPPED_H
 
-#include "memory_block.h"
 #include "main_memory.h"
 #include "cache_stats.h"
+#include "cache.h"
 
+// Default geometry, overridable at runtime through dmc_config
 #define DIRECT_MAPPED_NUM_SETS 16
 #define DIRECT_MAPPED_NUM_SETS_LN 4
 
+// A direct-mapped cache is the generic cache with a single way per set
+typedef cache direct_mapped_cache;
 
-typedef struct direct_mapped_cache
-{
-    main_memory* mm;
-    cache_stats cs;
-	memory_block* blocks[DIRECT_MAPPED_NUM_SETS];
-	int valid[DIRECT_MAPPED_NUM_SETS];
-	int dirty[DIRECT_MAPPED_NUM_SETS];
+// Returns the default direct-mapped geometry
+cache_config dmc_config();
 
-    
-    // TODO: add anything you need
-} direct_mapped_cache;
+// Runs num_records accesses in order, with the same results as the single
+// word calls; see cache_access_batch
+void dmc_access_batch(direct_mapped_cache* dmc,
+                      const trace_record* records, size_t num_records,
+                      unsigned int* vals);
 
 // Do not edit below this line
 
@@ -31,4 +31,4 @@ unsigned int dmc_load_word(direct_mapped_cache* dmc, void* addr);
 
 void dmc_free(direct_mapped_cache* dmc);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "event_log.h"
+
+// Prints an event log in the same format as a verbose run of main
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s event_log\n", argv[0]);
+        exit(1);
+    }
+
+    FILE* input_file = fopen(argv[1], "rb");
+    if (input_file == 0)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", argv[1]);
+        exit(3);
+    }
+
+    char magic[4];
+    uint32_t version;
+    if (fread(magic, 4, 1, input_file) != 1
+        || fread(&version, sizeof(version), 1, input_file) != 1
+        || memcmp(magic, EVENT_LOG_MAGIC, 4) != 0
+        || version != EVENT_LOG_VERSION)
+    {
+        fprintf(stderr, "Error: %s is not an event log.\n", argv[1]);
+        exit(2);
+    }
+
+    event_record r;
+    while (fread(&r, sizeof(r), 1, input_file) == 1)
+    {
+        void* addr = (void*) (uintptr_t) r.addr;
+        if (r.kind == EV_MM_READ)
+            printf("MM: Read %zu bytes at %p.\n", (size_t) r.val, addr);
+        else if (r.kind == EV_MM_WRITE)
+            printf("MM: Wrote %zu bytes at %p.\n", (size_t) r.val, addr);
+        else if (r.kind == EV_STORE)
+            printf("Wrote to %p: %d\n\n", addr, r.val);
+        else
+            printf("Read from %p: %d\n\n", addr, r.val);
+    }
+
+    fclose(input_file);
+    return 0;
+}
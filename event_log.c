@@ -0,0 +1,38 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "event_log.h"
+
+event_log* el_open(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == 0)
+        return 0;
+
+    uint32_t version = EVENT_LOG_VERSION;
+    fwrite(EVENT_LOG_MAGIC, 4, 1, file);
+    fwrite(&version, sizeof(version), 1, file);
+
+    event_log* result = malloc(sizeof(event_log));
+    result->file = file;
+    result->used = 0;
+    return result;
+}
+
+void el_flush(event_log* log)
+{
+    if (log->used && fwrite(log->buf, sizeof(event_record), log->used,
+                            log->file) != log->used)
+    {
+        fprintf(stderr, "Error: Could not write the event log.\n");
+        exit(4);
+    }
+    log->used = 0;
+}
+
+void el_close(event_log* log)
+{
+    el_flush(log);
+    fclose(log->file);
+    free(log);
+}
@@ -0,0 +1,56 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define EVENT_LOG_MAGIC "CSEV"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_BUFFER_SIZE (1 << 16)
+
+// Kinds of per-access events
+#define EV_MM_READ 0        // block read from main memory, val = block size
+#define EV_MM_WRITE 1       // block or word written to main memory,
+                            // val = bytes written
+#define EV_LOAD 2           // word loaded by the trace, val = value read
+#define EV_STORE 3          // word stored by the trace, val = value written
+
+// On-disk record, written in host byte order after an 8-byte header of
+// EVENT_LOG_MAGIC followed by the 32-bit EVENT_LOG_VERSION
+typedef struct event_record
+{
+    uint64_t addr;
+    uint32_t val;
+    uint8_t kind;
+    uint8_t pad[3];
+} event_record;
+
+// Buffered binary log of events, flushed in EVENT_LOG_BUFFER_SIZE chunks
+typedef struct event_log
+{
+    FILE* file;
+    size_t used;
+    event_record buf[EVENT_LOG_BUFFER_SIZE / sizeof(event_record)];
+} event_log;
+
+// Returns 0 if path cannot be created
+event_log* el_open(const char* path);
+
+void el_flush(event_log* log);
+
+static inline void el_append(event_log* log, uint8_t kind, void* addr,
+                             uint32_t val)
+{
+    if (log->used == sizeof(log->buf) / sizeof(log->buf[0]))
+        el_flush(log);
+    event_record* r = &log->buf[log->used++];
+    r->addr = (uintptr_t) addr;
+    r->val = val;
+    r->kind = kind;
+    r->pad[0] = r->pad[1] = r->pad[2] = 0;
+}
+
+// Flushes and closes the log
+void el_close(event_log* log);
+
+#endif
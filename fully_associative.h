@@ -3,24 +3,23 @@
 
 #include "main_memory.h"
 #include "cache_stats.h"
+#include "cache.h"
 
+// Default geometry, overridable at runtime through fac_config
 #define FULLY_ASSOCIATIVE_NUM_WAYS 16
 #define FULLY_ASSOCIATIVE_NUM_WAYS_LN 4
 
-typedef struct way{
-    memory_block* block;
-    int lru_priority;
-    int dirty;
-    int valid;
-
-} way;
-typedef struct fully_associative_cache
-{
-    main_memory* mm;
-    cache_stats cs;
-	way ways[FULLY_ASSOCIATIVE_NUM_WAYS];
-    // TODO: add anything you need
-} fully_associative_cache;
+// A fully associative cache is the generic cache with a single set
+typedef cache fully_associative_cache;
+
+// Returns the default fully associative geometry
+cache_config fac_config();
+
+// Runs num_records accesses in order, with the same results as the single
+// word calls; see cache_access_batch
+void fac_access_batch(fully_associative_cache* fac,
+                      const trace_record* records, size_t num_records,
+                      unsigned int* vals);
 
 // Do not edit below this line
 
@@ -32,4 +31,4 @@ unsigned int fac_load_word(fully_associative_cache* fac, void* addr);
 
 void fac_free(fully_associative_cache* fac);
 
-#endif
\ No newline at end of file
+#endif
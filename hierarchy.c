@@ -0,0 +1,65 @@
+#include <stdlib.h>
+
+#include "hierarchy.h"
+
+hierarchy* hy_init(main_memory* mm, const sim_config* configs,
+                   unsigned int num_levels, unsigned int mm_latency)
+{
+    hierarchy* result = malloc(sizeof(hierarchy));
+    result->num_levels = num_levels;
+    result->levels = malloc(num_levels * sizeof(cache));
+    result->latencies = malloc(num_levels * sizeof(unsigned int));
+    result->mm_latency = mm_latency;
+    result->mm = mm;
+
+    // Bottom up, so each level has its lower level to sit on
+    unsigned int i = num_levels;
+    while (i-- > 0)
+    {
+        cache_setup(&result->levels[i], mm, &configs[i].cfg);
+        if (i + 1 < num_levels)
+            cache_link(&result->levels[i], &result->levels[i + 1]);
+        result->latencies[i] = configs[i].latency;
+    }
+    return result;
+}
+
+double hy_amat(const hierarchy* hy)
+{
+    const cache_stats* l1 = &hy->levels[0].cs;
+    double queries = (double) l1->r_queries + l1->w_queries;
+    if (queries == 0)
+        return 0;
+
+    // Each lower level's block reads are exactly the misses above it, and
+    // the reads made for prefetches above
+    double cycles = hy->latencies[0] * queries;
+    unsigned int i;
+    for (i = 1; i < hy->num_levels; i++)
+    {
+        cycles += (double) hy->latencies[i]
+                  * ((double) hy->levels[i].cs.r_queries
+                     - cache_pf_reads_below(&hy->levels[i - 1]));
+    }
+    cycles += (double) hy->mm_latency
+              * ((double) hy->mm->r_queries
+                 - cache_pf_reads_below(&hy->levels[hy->num_levels - 1]));
+    return cycles / queries;
+}
+
+void hy_flush(hierarchy* hy)
+{
+    unsigned int i;
+    for (i = 0; i < hy->num_levels; i++)
+        cache_flush(&hy->levels[i]);
+}
+
+void hy_free(hierarchy* hy)
+{
+    unsigned int i;
+    for (i = 0; i < hy->num_levels; i++)
+        cache_release(&hy->levels[i]);
+    free(hy->levels);
+    free(hy->latencies);
+    free(hy);
+}
@@ -0,0 +1,49 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include "main_memory.h"
+#include "cache.h"
+#include "sim_config.h"
+
+// Cycles per main memory access unless --mm-latency is given
+#define HIERARCHY_MM_LATENCY 100
+
+// Caches stacked over one main memory. levels[0] is L1, which takes the
+// loads and stores; every level misses into and evicts to the one below it,
+// and the last one sits on main memory.
+typedef struct hierarchy
+{
+    unsigned int num_levels;
+    cache* levels;
+    unsigned int* latencies;    // cycles per access of each level
+    unsigned int mm_latency;    // cycles per block read from main memory
+    main_memory* mm;
+} hierarchy;
+
+// Builds the levels described by configs, L1 first, over mm. Every config
+// must be a dmc, fac or sac cache with mm's block size.
+hierarchy* hy_init(main_memory* mm, const sim_config* configs,
+                   unsigned int num_levels, unsigned int mm_latency);
+
+static inline void hy_store_word(hierarchy* hy, void* addr, unsigned int val)
+{
+    cache_store_word(&hy->levels[0], addr, val);
+}
+
+static inline unsigned int hy_load_word(hierarchy* hy, void* addr)
+{
+    return cache_load_word(&hy->levels[0], addr);
+}
+
+// Average memory access time in cycles: every access pays the L1 latency,
+// and each miss pays the latency of the level below it, down to main memory.
+// A hit in the victim or miss cache of a level costs nothing extra.
+// Write-backs and prefetch fills are off the critical path and not counted.
+double hy_amat(const hierarchy* hy);
+
+// Writes every dirty line down to main memory, top level first
+void hy_flush(hierarchy* hy);
+
+void hy_free(hierarchy* hy);
+
+#endif
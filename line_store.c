@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_store.h"
+
+void ls_init(line_store* ls, unsigned int num_lines, size_t block_size)
+{
+    ls->num_lines = num_lines;
+    ls->block_size = block_size;
+    ls->tags = malloc(num_lines * sizeof(void*));
+    unsigned int line;
+    for (line = 0; line < num_lines; line++)
+        ls->tags[line] = LS_NO_TAG;
+    ls->valid = calloc(num_lines, sizeof(unsigned char));
+    ls->dirty = calloc(num_lines, sizeof(unsigned char));
+
+    // aligned_alloc needs a size that is a multiple of the alignment
+    size_t data_size = (size_t) num_lines * block_size;
+    data_size = (data_size + LINE_STORE_ALIGN - 1) & ~(size_t) (LINE_STORE_ALIGN - 1);
+    ls->data = aligned_alloc(LINE_STORE_ALIGN, data_size);
+    memset(ls->data, 0, data_size);
+}
+
+void ls_evict(line_store* ls, const mem_level* below, unsigned int line)
+{
+    if (ls->valid[line] == 1 && (ls->dirty[line] == 1 || below->takes_clean))
+        below->write(below->self, ls->tags[line], ls_data(ls, line),
+                     ls->dirty[line]);
+}
+
+void ls_fill(line_store* ls, const mem_level* below, unsigned int line,
+             void* start_addr)
+{
+    ls_evict(ls, below, line);
+    // the block is gone once handed down, even if the read below ends up
+    // back-invalidating it
+    ls->tags[line] = LS_NO_TAG;
+    ls->valid[line] = 0;
+
+    int dirty;
+    below->read(below->self, start_addr, ls_data(ls, line), &dirty);
+    ls->tags[line] = start_addr;
+    ls->valid[line] = 1;
+    ls->dirty[line] = dirty;
+}
+
+void ls_claim(line_store* ls, const mem_level* below, unsigned int line,
+              void* start_addr)
+{
+    ls_evict(ls, below, line);
+    ls->tags[line] = start_addr;
+    ls->valid[line] = 1;
+    ls->dirty[line] = 0;
+}
+
+void ls_flush(line_store* ls, const mem_level* below)
+{
+    unsigned int line;
+    for (line = 0; line < ls->num_lines; line++)
+    {
+        if (ls->valid[line] == 1 && ls->dirty[line] == 1)
+        {
+            below->write(below->self, ls->tags[line], ls_data(ls, line), 1);
+            ls->dirty[line] = 0;
+        }
+    }
+}
+
+void ls_free(line_store* ls)
+{
+    free(ls->tags);
+    free(ls->valid);
+    free(ls->dirty);
+    free(ls->data);
+}
@@ -0,0 +1,124 @@
+#ifndef LINE_STORE_H
+#define LINE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(CACHE_SIM_NO_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "mem_level.h"
+
+// Alignment of the data slab, one host cache line
+#define LINE_STORE_ALIGN 64
+
+// Tag of the lines that hold no block. Blocks start at aligned addresses,
+// so none starts here, and lookups can compare tags without looking at
+// valid.
+#define LS_NO_TAG ((void*) UINTPTR_MAX)
+
+// Structure-of-arrays storage for the lines of a cache. Everything is
+// allocated once in ls_init, so fills and evictions never touch the allocator.
+typedef struct line_store
+{
+    unsigned int num_lines;
+    size_t block_size;
+    void** tags;            // start address of the block held by each line,
+                            // LS_NO_TAG if it holds none
+    unsigned char* valid;
+    unsigned char* dirty;
+    unsigned char* data;    // num_lines blocks of block_size bytes
+} line_store;
+
+void ls_init(line_store* ls, unsigned int num_lines, size_t block_size);
+
+// Returns a pointer to the data of line
+static inline void* ls_data(line_store* ls, unsigned int line)
+{
+    return ls->data + (size_t) line * ls->block_size;
+}
+
+// Returns the first of the num_ways lines from base whose tag is tag, or
+// -1. The tags are compared a vector at a time with AVX2 or SSE2 when the
+// build targets them and CACHE_SIM_NO_SIMD is not defined, and one by one
+// otherwise. The matches of up to 64 ways are gathered into one mask before
+// it is tested, so where the block sits does not steer a branch.
+static inline int ls_find(const line_store* ls, unsigned int base,
+                          unsigned int num_ways, void* tag)
+{
+    void* const* tags = ls->tags + base;
+    unsigned int start;
+    for (start = 0; start < num_ways; start += 64)
+    {
+        unsigned int end = num_ways - start < 64 ? num_ways : start + 64;
+        uint64_t mask = 0;
+        unsigned int i = start;
+#if !defined(CACHE_SIM_NO_SIMD) && UINTPTR_MAX == UINT64_MAX \
+    && defined(__AVX2__)
+        __m256i key = _mm256_set1_epi64x((long long) (uintptr_t) tag);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m256i eq = _mm256_cmpeq_epi64(
+                _mm256_loadu_si256((const __m256i*) (tags + i)), key);
+            mask |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(eq))
+                    << (i - start);
+        }
+#elif !defined(CACHE_SIM_NO_SIMD) && UINTPTR_MAX == UINT64_MAX \
+    && defined(__SSE2__)
+        // SSE2 has no 64-bit compare: a lane matches if both its halves do
+        __m128i key = _mm_set1_epi64x((long long) (uintptr_t) tag);
+        for (; i + 2 <= end; i += 2)
+        {
+            __m128i eq = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i*) (tags + i)), key);
+            eq = _mm_and_si128(eq,
+                               _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+            mask |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(eq))
+                    << (i - start);
+        }
+#elif !defined(CACHE_SIM_NO_SIMD) && defined(__SSE2__)
+        __m128i key = _mm_set1_epi32((int) (uintptr_t) tag);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128i eq = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i*) (tags + i)), key);
+            mask |= (uint64_t) _mm_movemask_ps(_mm_castsi128_ps(eq))
+                    << (i - start);
+        }
+#endif
+        for (; i < end; i++)
+            mask |= (uint64_t) (tags[i] == tag) << (i - start);
+        if (mask)
+            return start + __builtin_ctzll(mask);
+    }
+    return -1;
+}
+
+// Empties line, which must not be dirty or must have been written back
+static inline void ls_invalidate(line_store* ls, unsigned int line)
+{
+    ls->tags[line] = LS_NO_TAG;
+    ls->valid[line] = 0;
+    ls->dirty[line] = 0;
+}
+
+// Hands the block in line down to below if below wants it: when it is
+// dirty, or always if below takes clean blocks. The line is left as is.
+void ls_evict(line_store* ls, const mem_level* below, unsigned int line);
+
+// Evicts line, then loads the block starting at start_addr into it from below
+void ls_fill(line_store* ls, const mem_level* below, unsigned int line,
+             void* start_addr);
+
+// Evicts line and gives it to the block starting at start_addr, clean and
+// without loading it, for a caller about to overwrite the whole block
+void ls_claim(line_store* ls, const mem_level* below, unsigned int line,
+              void* start_addr);
+
+// Writes every dirty line down to below and marks it clean
+void ls_flush(line_store* ls, const mem_level* below);
+
+void ls_free(line_store* ls);
+
+#endif
@@ -2,19 +2,128 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <math.h>
 
 #include "main_memory.h"
-#include "simple.h"
-#include "direct_mapped.h"
-#include "fully_associative.h"
-#include "set_associative.h"
+#include "multi_sim.h"
+#include "stack_distance.h"
+#include "sampling.h"
+#include "hierarchy.h"
+#include "coherence.h"
+#include "parallel_mc.h"
+#include "trace.h"
 
-#define MODE_SC 0
-#define MODE_DMC 1
-#define MODE_FAC 2
-#define MODE_SAC 3
+// Prints what the write buffer of mm took in, if it has one. Stores still
+// pending in it at the end are not in the writes to main memory.
+static void print_write_buffer(main_memory* mm)
+{
+    if (mm->wbuf == 0)
+        return;
+    printf("Buffered Writes:\t%u (%u merged, %u pending)\n",
+           mm->wbuf->stores, mm->wbuf->merges, mm->wbuf->count);
+}
+
+// Prints the prefetch counters of a cache with a prefetcher. Accuracy is
+// the share of prefetches that were used, coverage the share of would-be
+// misses that prefetches turned into hits.
+static void print_prefetches(cache_stats cs)
+{
+    unsigned int misses = cs.r_misses + cs.w_misses;
+    printf("Prefetches:\t\t%u (%u useful, %u late, %u polluting)\n",
+           cs.pf_issued, cs.pf_useful, cs.pf_late, cs.pf_polluting);
+    printf("Prefetch Accuracy:\t%.0lf%%\n",
+           (double) cs.pf_useful / (double) cs.pf_issued * 100);
+    printf("Prefetch Coverage:\t%.0lf%%\n",
+           (double) cs.pf_useful / (double) (cs.pf_useful + misses) * 100);
+}
+
+// Prints the hit rate of the victim or miss cache of a cache. Its reads are
+// the misses of the cache above it.
+static void print_victim(const cache* c)
+{
+    const char* kind = c->victim->spare_way ? "Victim" : "Miss";
+    cache_stats cs = c->victim->cs;
+    int r_hits = cs.r_queries - cs.r_misses;
+    printf("%s Cache:\t\t%u entries\n", kind,
+           c->victim->num_ways - c->victim->spare_way);
+    printf("%s Cache Hit Rate:\t%.0lf%% (%d/%d)\n", kind,
+           (double) r_hits / (double) cs.r_queries * 100, r_hits,
+           cs.r_queries);
+}
+
+// Prints the misses of a profiled cache by class, and the set with the
+// most misses
+static void print_profile(const cache_profile* prof)
+{
+    unsigned int misses[3];
+    prof_misses(prof, misses);
+    printf("Compulsory Misses:\t%u\n", misses[PROF_COMPULSORY]);
+    printf("Capacity Misses:\t%u\n", misses[PROF_CAPACITY]);
+    printf("Conflict Misses:\t%u\n", misses[PROF_CONFLICT]);
+    unsigned int set = prof_hottest_set(prof);
+    const prof_set* s = &prof->sets[set];
+    printf("Hottest Set:\t\t%u (%u misses, %u evictions)\n", set,
+           s->misses[PROF_COMPULSORY] + s->misses[PROF_CAPACITY]
+           + s->misses[PROF_CONFLICT], s->evictions);
+}
 
-void print_stats(main_memory* mm, cache_stats cs)
+// Prints the stats of the prefetcher, the victim or miss cache and the
+// profile of c, for those it has
+static void print_extras(const cache* c)
+{
+    if (c->prefetch)
+        print_prefetches(c->cs);
+    if (c->victim)
+        print_victim(c);
+    if (c->profile)
+        print_profile(c->profile);
+}
+
+// Writes the per-set and hottest block tables of a profiled cache to
+// prefix-sets.csv and prefix-blocks.csv
+static void write_profile(const cache* c, const char* prefix)
+{
+    const char* suffixes[2] = { "-sets.csv", "-blocks.csv" };
+    int k;
+    for (k = 0; k < 2; k++)
+    {
+        char* path = malloc(strlen(prefix) + strlen(suffixes[k]) + 1);
+        strcpy(path, prefix);
+        strcat(path, suffixes[k]);
+        FILE* file = fopen(path, "w");
+        if (file == 0)
+        {
+            fprintf(stderr, "Error: Could not create %s.\n", path);
+            exit(3);
+        }
+        if (k == 0)
+            prof_write_sets(c->profile, file);
+        else
+            prof_write_blocks(c->profile, file, c->lines.block_size);
+        fclose(file);
+        free(path);
+    }
+}
+
+// Prints the cycles of a timed run, the average access time, the memory
+// level parallelism and how busy the bus to main memory was
+static void print_timing(const timing* tm)
+{
+    printf("Cycles:\t\t\t%llu\n", timing_cycles(tm));
+    printf("AMAT:\t\t\t%.2lf cycles\n", timing_amat(tm));
+    printf("MSHR Misses:\t\t%u (%u merged, %llu stall cycles)\n",
+           tm->misses, tm->merges, tm->stall_cycles);
+    printf("MLP:\t\t\t%.2lf\n", timing_mlp(tm));
+    printf("Bus Utilization:\t%.0lf%% (%u blocks, %u words)\n",
+           timing_bus_utilization(tm) * 100, tm->transfers,
+           tm->word_transfers);
+}
+
+// c is the cache the stats are of, or 0 for sc; tm is its timing, or 0
+void print_stats(main_memory* mm, cache_stats cs, const cache* c,
+                 const timing* tm)
 {   
     int w_hits = cs.w_queries - cs.w_misses;
     int r_hits = cs.r_queries - cs.r_misses;
@@ -30,130 +139,947 @@ void print_stats(main_memory* mm, cache_stats cs)
     printf("Write Hit Rate:\t\t%.0lf%% (%d/%d)\n", whr, w_hits, cs.w_queries);
     printf("Read Hit Rate:\t\t%.0lf%% (%d/%d)\n", rhr, r_hits, cs.r_queries);
     printf("Total Hit Rate:\t\t%.0lf%% (%d/%d)\n", thr, t_hits, t_queries);
+    if (c)
+        print_extras(c);
     printf("Writes to Main Memory:\t%d\n", mm->w_queries);
     printf("Reads from Main Memory:\t%d\n", mm->r_queries);
+    print_write_buffer(mm);
+    if (tm)
+        print_timing(tm);
     printf("*******************************************\n");
 }
 
-int main(int argc, char* argv[])
+// Prints the hit rate lines of print_stats for one level of a hierarchy
+static void print_hit_rates(cache_stats cs)
 {
-    if (argc != 3)
+    int w_hits = cs.w_queries - cs.w_misses;
+    int r_hits = cs.r_queries - cs.r_misses;
+    int t_hits = w_hits + r_hits;
+    unsigned int t_queries = cs.w_queries + cs.r_queries;
+
+    printf("Write Hit Rate:\t\t%.0lf%% (%d/%d)\n",
+           (double) w_hits / (double) cs.w_queries * 100, w_hits, cs.w_queries);
+    printf("Read Hit Rate:\t\t%.0lf%% (%d/%d)\n",
+           (double) r_hits / (double) cs.r_queries * 100, r_hits, cs.r_queries);
+    printf("Total Hit Rate:\t\t%.0lf%% (%d/%d)\n",
+           (double) t_hits / (double) t_queries * 100, t_hits, t_queries);
+}
+
+// print_stats for a hierarchy: the hit rates of each level, then main
+// memory traffic and the average access time. Below L1 the reads are block
+// reads on misses above and the writes are blocks evicted from above.
+void print_hierarchy_stats(hierarchy* hy, const sim_config* configs)
+{
+    printf("*******************************************\n");
+    unsigned int i;
+    for (i = 0; i < hy->num_levels; i++)
     {
-        fprintf(stderr, "Usage: %s sc|dmc|fac|sac input_file\n", argv[0]);
-        exit(1);
+        printf("L%u: %s (latency %u)\n", i + 1, configs[i].name,
+               hy->latencies[i]);
+        print_hit_rates(hy->levels[i].cs);
+        print_extras(&hy->levels[i]);
     }
-    
-    int mode;
-    if (strcmp(argv[1], "sc") == 0)
-        mode = MODE_SC;
-    else if (strcmp(argv[1], "dmc") == 0)
-        mode = MODE_DMC;
-    else if (strcmp(argv[1], "fac") == 0)
-        mode = MODE_FAC;
-    else if (strcmp(argv[1], "sac") == 0)
-        mode = MODE_SAC;
+    printf("Writes to Main Memory:\t%d\n", hy->mm->w_queries);
+    printf("Reads from Main Memory:\t%d\n", hy->mm->r_queries);
+    print_write_buffer(hy->mm);
+    printf("AMAT:\t\t\t%.2lf cycles\n", hy_amat(hy));
+    printf("*******************************************\n");
+}
+
+// Runs the trace at path through a hierarchy of the levels in list
+static void run_hierarchy(const char* path, const sim_config_list* list,
+                          size_t block_size, size_t mem_size,
+                          unsigned int mm_latency, int quiet,
+                          const char* event_log_path, const char* dump_path,
+                          unsigned int wb_entries, unsigned int wb_batch)
+{
+    main_memory* mm = mm_init(mem_size, block_size);
+    mm->verbose = !quiet;
+    if (wb_entries)
+        mm_set_write_buffer(mm, wb_entries, wb_batch);
+    if (event_log_path)
+    {
+        mm->log = el_open(event_log_path);
+        if (mm->log == 0)
+        {
+            fprintf(stderr, "Error: Could not create %s.\n", event_log_path);
+            exit(3);
+        }
+    }
+    hierarchy* hy = hy_init(mm, list->configs, list->num_configs, mm_latency);
+
+    trace_reader tr;
+    if (!tr_open(&tr, path))
+        exit(3);
+    trace_record r;
+    while (tr_next(&tr, &r))
+    {
+        void* addr = (void*) r.addr;
+        unsigned int val = r.val;
+        if (r.op == TRACE_WRITE)
+        {
+            hy_store_word(hy, addr, val);
+            if (mm_tracing(mm))
+                mm_trace(mm, EV_STORE, addr, val);
+        }
+        else
+        {
+            val = hy_load_word(hy, addr);
+            if (mm_tracing(mm))
+                mm_trace(mm, EV_LOAD, addr, val);
+        }
+    }
+    tr_close(&tr);
+    print_hierarchy_stats(hy, list->configs);
+
+    if (mm->log)
+        el_close(mm->log);
+    mm->verbose = 0;
+    mm->log = 0;
+    if (dump_path)
+    {
+        hy_flush(hy);
+        if (!mm_dump(mm, dump_path))
+        {
+            fprintf(stderr, "Error: Could not write %s.\n", dump_path);
+            exit(3);
+        }
+    }
+    hy_free(hy);
+    mm_free(mm);
+}
+
+// print_stats for a multicore run: the hit rates and coherence events of
+// each core, the shared L2 if there is one, then main memory traffic
+void print_multicore_stats(coh_system* sys, const sim_config* l1,
+                           cache* l2, const sim_config* l2_config,
+                           main_memory* mm)
+{
+    printf("*******************************************\n");
+    unsigned int i;
+    for (i = 0; i < sys->num_cores; i++)
+    {
+        cache_stats cs = sys->cores[i].l1.cs;
+        printf("Core %u: %s (%s)\n", i, l1->name,
+               sys->protocol == COH_MOESI ? "moesi" : "mesi");
+        print_hit_rates(cs);
+        printf("Upgrades:\t\t%u\n", cs.upgrades);
+        printf("Invalidations:\t\t%u\n", cs.invalidations);
+        printf("Coherence Misses:\t%u\n", cs.coherence_misses);
+    }
+    if (l2)
+    {
+        printf("Shared L2: %s\n", l2_config->name);
+        print_hit_rates(l2->cs);
+        print_extras(l2);
+    }
+    printf("Writes to Main Memory:\t%d\n", mm->w_queries);
+    printf("Reads from Main Memory:\t%d\n", mm->r_queries);
+    print_write_buffer(mm);
+    printf("*******************************************\n");
+}
+
+// Runs one trace per core through coherent private l1 caches over main
+// memory, or over a shared l2_config cache if it is not 0. The cores take
+// turns, one access each, until every trace has ended. With num_threads
+// set, they run on that many threads instead, epoch rounds at a time; see
+// pmc_run. wb_entries other than 0 puts a write buffer in front of memory.
+static void run_multicore(const char** paths, unsigned int num_cores,
+                          int protocol, const sim_config* l1,
+                          const sim_config* l2_config, size_t block_size,
+                          size_t mem_size, int quiet, const char* dump_path,
+                          unsigned int num_threads, unsigned int epoch,
+                          int exact, unsigned int wb_entries,
+                          unsigned int wb_batch)
+{
+    main_memory* mm = mm_init(mem_size, block_size);
+    mm->verbose = !quiet;
+    if (wb_entries)
+        mm_set_write_buffer(mm, wb_entries, wb_batch);
+    mem_level shared = mm_level(mm);
+    cache l2;
+    if (l2_config)
+    {
+        cache_setup(&l2, mm, &l2_config->cfg);
+        shared = cache_as_level(&l2);
+    }
+    coh_system* sys = coh_init(protocol, num_cores, &l1->cfg, block_size,
+                               &shared);
+
+    trace_reader* readers = malloc(num_cores * sizeof(trace_reader));
+    unsigned int* live = malloc(num_cores * sizeof(unsigned int));
+    unsigned int num_live = num_cores;
+    unsigned int i;
+    for (i = 0; i < num_cores; i++)
+    {
+        if (!tr_open(&readers[i], paths[i]))
+            exit(3);
+        live[i] = i;
+    }
+    if (num_threads)
+    {
+        pmc_run(sys, readers, num_threads, epoch, exact);
+        num_live = 0;
+    }
+    while (num_live > 0)
+    {
+        unsigned int j = 0;
+        while (j < num_live)
+        {
+            unsigned int core = live[j];
+            trace_record r;
+            if (!tr_next(&readers[core], &r))
+            {
+                // keep the turn order of the cores still running
+                memmove(live + j, live + j + 1,
+                        (num_live - j - 1) * sizeof(unsigned int));
+                --num_live;
+                continue;
+            }
+            void* addr = (void*) r.addr;
+            unsigned int val = r.val;
+            if (r.op == TRACE_WRITE)
+            {
+                coh_store_word(sys, core, addr, val);
+                if (mm_tracing(mm))
+                    mm_trace(mm, EV_STORE, addr, val);
+            }
+            else
+            {
+                val = coh_load_word(sys, core, addr);
+                if (mm_tracing(mm))
+                    mm_trace(mm, EV_LOAD, addr, val);
+            }
+            ++j;
+        }
+    }
+    for (i = 0; i < num_cores; i++)
+        tr_close(&readers[i]);
+    print_multicore_stats(sys, l1, l2_config ? &l2 : 0, l2_config, mm);
+
+    mm->verbose = 0;
+    if (dump_path)
+    {
+        coh_flush(sys);
+        if (l2_config)
+            cache_flush(&l2);
+        if (!mm_dump(mm, dump_path))
+        {
+            fprintf(stderr, "Error: Could not write %s.\n", dump_path);
+            exit(3);
+        }
+    }
+    coh_free(sys);
+    if (l2_config)
+        cache_release(&l2);
+    free(readers);
+    free(live);
+    mm_free(mm);
+}
+
+// Prints the LRU hits of every number of ways, at each size where they
+// change; the last row holds for all larger caches
+void print_curve(stack_distance* sd)
+{
+    unsigned long long r_hits = 0;
+    unsigned long long w_hits = 0;
+    unsigned long long queries = sd->r_queries + sd->w_queries;
+
+    printf("*******************************************\n");
+    printf("LRU hits by ways (sets: %u, block size: %zu)\n",
+           sd->layout.num_sets, sd->layout.block_size);
+    printf("Ways\tRead Hits\tWrite Hits\tTotal Hit Rate\n");
+    size_t d;
+    for (d = 0; d < sd->max_distance; d++)
+    {
+        if (sd->r_hist[d] == 0 && sd->w_hist[d] == 0)
+            continue;
+        r_hits += sd->r_hist[d];
+        w_hits += sd->w_hist[d];
+        printf("%zu\t%llu/%llu\t%llu/%llu\t%.2lf%%\n", d + 1,
+               r_hits, sd->r_queries, w_hits, sd->w_queries,
+               (double) (r_hits + w_hits) / (double) queries * 100);
+    }
+    printf("Cold misses:\t%llu\n", sd->r_cold + sd->w_cold);
+    printf("*******************************************\n");
+}
+
+// Runs the stack-distance analysis of the trace at path
+static void analyze(const char* path, size_t block_size, size_t sets)
+{
+    stack_distance* sd = sd_init(block_size, sets ? sets : 1);
+    trace_reader tr;
+    if (!tr_open(&tr, path))
+        exit(3);
+    trace_record r;
+    while (tr_next(&tr, &r))
+        sd_access(sd, r.addr, r.op == TRACE_WRITE);
+    tr_close(&tr);
+    print_curve(sd);
+    sd_free(sd);
+}
+
+// Prints one estimated hit rate line of print_sampled_stats
+static void print_rate(const char* label, smp_rate rate, unsigned int queries)
+{
+    printf("%s%.1lf%% ", label, rate.rate * 100);
+    if (isnan(rate.error))
+        printf("(no interval) ");
     else
+        printf("+/- %.1lf%% ", rate.error * 100);
+    printf("(~%.0lf/%u)\n", rate.rate * queries, queries);
+}
+
+// print_stats for a sampled run: estimates scaled to the whole trace, with
+// 95% confidence intervals
+void print_sampled_stats(sampler* smp)
+{
+    smp_rate read, write, total;
+    smp_hit_rates(smp, &read, &write, &total);
+    double fraction = smp_fraction(smp);
+
+    printf("*******************************************\n");
+    printf("Measured %.2lf%% of the accesses", fraction * 100);
+    if (smp->set_ratio > 1)
+        printf(", %u of %u sets", smp->num_sampled, smp->c->num_sets);
+    if (smp->period)
+        printf(", %llu of every %llu after %llu of warm-up", smp->window,
+               smp->period, smp->warmup);
+    printf("\n");
+    print_rate("Write Hit Rate:\t\t", write, smp->total.w_queries);
+    print_rate("Read Hit Rate:\t\t", read, smp->total.r_queries);
+    print_rate("Total Hit Rate:\t\t", total,
+               smp->total.w_queries + smp->total.r_queries);
+    printf("Writes to Main Memory:\t~%.0lf\n",
+           fraction > 0 ? smp->mm_writes / fraction : 0);
+    printf("Reads from Main Memory:\t~%.0lf\n",
+           fraction > 0 ? smp->mm_reads / fraction : 0);
+    printf("*******************************************\n");
+}
+
+// Parses --sample-time WINDOW/PERIOD[/WARMUP]; warm-up defaults to a window
+static void parse_sample_time(const char* str, unsigned long long* window,
+                              unsigned long long* period,
+                              unsigned long long* warmup)
+{
+    char* copy = strdup(str);
+    char* save;
+    char* w = strtok_r(copy, "/", &save);
+    char* p = w ? strtok_r(0, "/", &save) : 0;
+    char* u = p ? strtok_r(0, "/", &save) : 0;
+    if (p == 0 || strtok_r(0, "/", &save) != 0)
     {
-        fprintf(stderr, "Error: Mode must be sc, dmc, fac, or sac.\n");
-        exit (2);
+        fprintf(stderr, "Error: --sample-time expects WINDOW/PERIOD[/WARMUP],"
+                        " got '%s'.\n", str);
+        exit(2);
     }
-    
-    FILE* input_file = fopen(argv[2], "r");
-    if (input_file == 0)
+    *window = cfg_parse_count("--sample-time", w);
+    *period = cfg_parse_count("--sample-time", p);
+    *warmup = u ? cfg_parse_count("--sample-time", u) : *window;
+    if (*window + *warmup > *period)
+    {
+        fprintf(stderr, "Error: The window and warm-up must fit in the"
+                        " period.\n");
+        exit(2);
+    }
+    free(copy);
+}
+
+// Parses --write-buffer ENTRIES[/BATCH]; the batch defaults to all entries
+static void parse_write_buffer(const char* str, size_t* entries,
+                               size_t* batch)
+{
+    char* copy = strdup(str);
+    char* save;
+    char* e = strtok_r(copy, "/", &save);
+    char* b = e ? strtok_r(0, "/", &save) : 0;
+    if (e == 0 || strtok_r(0, "/", &save) != 0)
+    {
+        fprintf(stderr, "Error: --write-buffer expects ENTRIES[/BATCH],"
+                        " got '%s'.\n", str);
+        exit(2);
+    }
+    *entries = cfg_parse_count("--write-buffer", e);
+    *batch = b ? cfg_parse_count("--write-buffer", b) : *entries;
+    if (*entries > UINT_MAX || *batch > *entries)
+    {
+        fprintf(stderr, "Error: The write buffer batch must fit in its"
+                        " entries.\n");
+        exit(2);
+    }
+    free(copy);
+}
+
+// Runs the sampled simulation of c over the trace at path
+static void run_sampled(const char* path, sim_instance* sim,
+                        unsigned int set_ratio, unsigned long long window,
+                        unsigned long long period, unsigned long long warmup)
+{
+    sampler* smp = smp_init(&sim->c, &sim->mm, set_ratio, period, window,
+                            warmup);
+    trace_reader tr;
+    if (!tr_open(&tr, path))
+        exit(3);
+    trace_record r;
+    while (tr_next(&tr, &r))
+        smp_access(smp, &r);
+    tr_close(&tr);
+    print_sampled_stats(smp);
+    smp_free(smp);
+}
+
+// Writes the final contents of the memory of sim to path, with the dirty
+// lines of its cache written back first. The write-backs come after the
+// statistics, so they are neither printed nor counted.
+static void dump_memory(sim_instance* sim, const char* path)
+{
+    sim->mm.verbose = 0;
+    sim->mm.log = 0;
+    if (sim->mode != MODE_SC)
+        cache_flush(&sim->c);
+    if (!mm_dump(&sim->mm, path))
     {
-        fprintf(stderr, "Error: Could not open %s.\n", argv[2]);
+        fprintf(stderr, "Error: Could not write %s.\n", path);
         exit(3);
     }
-    
-    main_memory* mm = mm_init();
-    simple_cache* sc = 0;
-    direct_mapped_cache* dmc = 0;
-    fully_associative_cache* fac = 0;
-    set_associative_cache* sac = 0;
-    if (mode == MODE_SC)
-        sc = sc_init(mm);
-    else if (mode == MODE_DMC)
-        dmc = dmc_init(mm);
-    else if (mode == MODE_FAC)
-        fac = fac_init(mm);
-    else if (mode == MODE_SAC)
-        sac = sac_init(mm);
-    
-    char* line = 0;
-    size_t line_len = 0;
-    unsigned int line_num = 0;
-    while (getline(&line, &line_len, input_file) != -1)
-    {
-        ++line_num;
-        
-        char RW;
-        void* addr;
-        unsigned int val;
-        
-        int tolkens_found = sscanf(line, "%c %p %d", &RW, &addr, &val);
-
-        if (strlen(line) != 1 && RW != '#')
-        {
-            if ((RW != 'R' && RW != 'W')
-                || (RW == 'R' && tolkens_found != 2)
-                || (RW == 'W' && tolkens_found !=3))
-                fprintf(stderr, "Warning: Format error on line %d: %s", line_num,
-                        line);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [--sets N] [--ways N] [--block N] [--mem N]"
+                    " [--policy P] [--quiet] [--event-log FILE]"
+                    " [--dump-memory FILE] [--write back|through]"
+                    " [--alloc yes|no] [--write-buffer N[/B]]"
+                    " [--prefetch P [--prefetch-degree N]"
+                    " [--prefetch-distance N]]"
+                    " [--victim N | --miss-cache N]"
+                    " [--timing [--hit-latency N] [--mm-latency N]"
+                    " [--bus-cycles N] [--mshrs N]]"
+                    " [--profile PREFIX]"
+                    " [--sample-sets N] [--sample-time W/P[/U]]"
+                    " sc|dmc|fac|sac input_file\n"
+                    "       %s [--block N] [--mem N] --config SPEC"
+                    " [--config SPEC ...] input_file\n"
+                    "       %s [--block N] [--mem N] [--mm-latency N]"
+                    " --level SPEC [--level SPEC ...] input_file\n"
+                    "       %s [--sets N] [--ways N] [--policy P] [--block N]"
+                    " [--mem N] [--protocol mesi|moesi] [--l2 SPEC] [--quiet]"
+                    " [--dump-memory FILE] [--threads N [--epoch N]"
+                    " [--deterministic]] mc core0_file [core1_file ...]\n"
+                    "       %s [--sets N] [--block N] sd input_file\n"
+                    "input_file is a text trace or a binary trace made by"
+                    " trace_convert\n"
+                    CFG_SPEC_HELP
+                    "--write-buffer coalesces writes to memory in N blocks,"
+                    " draining B at a time when full; it applies to every"
+                    " mode but sd\n"
+                    "--timing adds cycles, AMAT, MLP and bus utilization"
+                    " for single caches and --config lists\n"
+                    "--level stacks caches L1 first; its SPEC also takes"
+                    " ,incl=nine|inclusive|exclusive and ,lat=CYCLES\n"
+                    "sd prints LRU hits for every number of ways in one pass\n"
+                    "--sample-sets simulates 1 in N sets; --sample-time"
+                    " measures W of every P accesses after U of warm-up\n"
+                    "Policies: %s\n"
+                    "Prefetchers: %s\n", prog, prog, prog, prog, prog,
+                    repl_names(), pf_names());
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    // Geometry flags; 0 means use the default for the mode
+    size_t sets = 0;
+    size_t ways = 0;
+    size_t block_size = MAIN_MEMORY_BLOCK_SIZE;
+    size_t mem_size = MAIN_MEMORY_SIZE;
+    const replacement_policy* policy = 0;
+
+    // Write policy flags; 0 means write-back, write-allocate and no buffer
+    const char* write = 0;
+    const char* alloc = 0;
+    size_t wb_entries = 0;
+    size_t wb_batch = 0;
+
+    // Prefetch flags; 0 means no prefetcher
+    const char* prefetch = 0;
+    const char* pf_degree = 0;
+    const char* pf_distance = 0;
+
+    // Victim and miss cache entries; 0 means neither
+    const char* victim = 0;
+    const char* misscache = 0;
+
+    // Timing flags; 0 means the defaults of timing.h
+    int timed = 0;
+    size_t hit_latency = 0;
+    size_t bus_cycles = 0;
+    size_t num_mshrs = 0;
+
+    // Output flags
+    int quiet = 0;
+    const char* event_log_path = 0;
+    const char* dump_path = 0;
+    const char* profile_prefix = 0;
+
+    // Sampling flags; a ratio of 1 and a period of 0 mean no sampling
+    size_t set_ratio = 1;
+    unsigned long long window = 0;
+    unsigned long long period = 0;
+    unsigned long long warmup = 0;
+
+    // --config specs, parsed once all flags are known
+    const char** specs = malloc(argc * sizeof(char*));
+    unsigned int num_specs = 0;
+
+    // --level specs of a hierarchy, L1 first
+    const char** levels = malloc(argc * sizeof(char*));
+    unsigned int num_levels = 0;
+    size_t mm_latency = HIERARCHY_MM_LATENCY;
+
+    // Multicore flags; no protocol means mesi
+    const char* protocol_name = 0;
+    const char* l2_spec = 0;
+    size_t num_threads = 0;
+    size_t epoch = 0;
+    int exact = 0;
+
+    char** positional = malloc(argc * sizeof(char*));
+    int num_positional = 0;
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quiet") == 0)
+            quiet = 1;
+        else if (strcmp(argv[i], "--deterministic") == 0)
+            exact = 1;
+        else if (strcmp(argv[i], "--timing") == 0)
+            timed = 1;
+        else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            if (strcmp(argv[i], "--sets") == 0)
+                sets = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--ways") == 0)
+                ways = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--block") == 0)
+                block_size = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--mem") == 0)
+                mem_size = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--event-log") == 0)
+                event_log_path = argv[i + 1];
+            else if (strcmp(argv[i], "--dump-memory") == 0)
+                dump_path = argv[i + 1];
+            else if (strcmp(argv[i], "--profile") == 0)
+                profile_prefix = argv[i + 1];
+            else if (strcmp(argv[i], "--policy") == 0)
+                policy = cfg_parse_policy(argv[i + 1]);
+            else if (strcmp(argv[i], "--write") == 0)
+                write = argv[i + 1];
+            else if (strcmp(argv[i], "--alloc") == 0)
+                alloc = argv[i + 1];
+            else if (strcmp(argv[i], "--write-buffer") == 0)
+                parse_write_buffer(argv[i + 1], &wb_entries, &wb_batch);
+            else if (strcmp(argv[i], "--prefetch") == 0)
+                prefetch = argv[i + 1];
+            else if (strcmp(argv[i], "--prefetch-degree") == 0)
+                pf_degree = argv[i + 1];
+            else if (strcmp(argv[i], "--prefetch-distance") == 0)
+                pf_distance = argv[i + 1];
+            else if (strcmp(argv[i], "--victim") == 0)
+                victim = argv[i + 1];
+            else if (strcmp(argv[i], "--miss-cache") == 0)
+                misscache = argv[i + 1];
+            else if (strcmp(argv[i], "--config") == 0)
+                specs[num_specs++] = argv[i + 1];
+            else if (strcmp(argv[i], "--level") == 0)
+                levels[num_levels++] = argv[i + 1];
+            else if (strcmp(argv[i], "--mm-latency") == 0)
+                mm_latency = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--protocol") == 0)
+                protocol_name = argv[i + 1];
+            else if (strcmp(argv[i], "--l2") == 0)
+                l2_spec = argv[i + 1];
+            else if (strcmp(argv[i], "--threads") == 0)
+                num_threads = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--epoch") == 0)
+                epoch = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--hit-latency") == 0)
+                hit_latency = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--bus-cycles") == 0)
+                bus_cycles = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--mshrs") == 0)
+                num_mshrs = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--sample-sets") == 0)
+                set_ratio = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--sample-time") == 0)
+                parse_sample_time(argv[i + 1], &window, &period, &warmup);
             else
             {
-                if (RW == 'W')
-                {
-                    if (mode == MODE_SC)
-                        sc_store_word(sc, addr, val);
-                    else if (mode == MODE_DMC)
-                        dmc_store_word(dmc, addr, val);
-                    else if (mode == MODE_FAC)
-                        fac_store_word(fac, addr, val);
-                    else if (mode == MODE_SAC)
-                        sac_store_word(sac, addr, val);
-                    printf("Wrote to %p: %d\n\n", addr, val);
-                }
-                else
-                {
-                    if (mode == MODE_SC)
-                        val = sc_load_word(sc, addr);
-                    else if (mode == MODE_DMC)
-                        val = dmc_load_word(dmc, addr);
-                    else if (mode == MODE_FAC)
-                        val = fac_load_word(fac, addr);
-                    else if (mode == MODE_SAC)
-                        val = sac_load_word(sac, addr);
-                    printf("Read from %p: %d\n\n", addr, val);
-                }
+                fprintf(stderr, "Error: Unknown option %s.\n", argv[i]);
+                exit(2);
+            }
+            ++i;
+        }
+        else
+            positional[num_positional++] = argv[i];
+    }
+
+#ifndef CACHE_SIM_PROFILE
+    if (profile_prefix)
+    {
+        fprintf(stderr, "Error: --profile needs a build made with"
+                        " make PROFILE=on.\n");
+        exit(2);
+    }
+#endif
+    if ((hit_latency || bus_cycles || num_mshrs) && !timed)
+    {
+        fprintf(stderr, "Error: --hit-latency, --bus-cycles and --mshrs need"
+                        " --timing.\n");
+        exit(2);
+    }
+    if (hit_latency > UINT_MAX || bus_cycles > UINT_MAX
+        || num_mshrs > UINT_MAX || mm_latency > UINT_MAX)
+    {
+        fprintf(stderr, "Error: Latency, bus cycles or MSHRs too large.\n");
+        exit(2);
+    }
+
+    if (num_specs == 0 && num_levels == 0 && num_positional >= 2
+        && strcmp(positional[0], "mc") == 0)
+    {
+        int protocol = coh_find_protocol(protocol_name ? protocol_name
+                                                       : "mesi");
+        if (protocol < 0)
+        {
+            fprintf(stderr, "Error: Unknown protocol %s. Protocols: mesi"
+                            " moesi\n", protocol_name);
+            exit(2);
+        }
+        if (set_ratio > 1 || period || event_log_path || timed
+            || profile_prefix)
+        {
+            fprintf(stderr, "Error: mc takes no sampling, event log, timing"
+                            " or profile.\n");
+            exit(2);
+        }
+        if (write || alloc)
+        {
+            fprintf(stderr, "Error: mc caches are write-back,"
+                            " write-allocate.\n");
+            exit(2);
+        }
+        if (prefetch || pf_degree || pf_distance || victim || misscache)
+        {
+            fprintf(stderr, "Error: Only the mc L2 prefetches or has a"
+                            " victim or miss cache; give it in --l2.\n");
+            exit(2);
+        }
+        if ((epoch || exact) && !num_threads)
+        {
+            fprintf(stderr, "Error: --epoch and --deterministic need"
+                            " --threads.\n");
+            exit(2);
+        }
+        if (num_threads && !quiet)
+        {
+            fprintf(stderr, "Error: --threads needs --quiet.\n");
+            exit(2);
+        }
+        if (num_threads > UINT_MAX || epoch > UINT_MAX)
+        {
+            fprintf(stderr, "Error: Too many threads or rounds per"
+                            " epoch.\n");
+            exit(2);
+        }
+        sim_config l1;
+        cfg_make("sac", sets, ways, block_size, mem_size, policy, &l1);
+        sim_config_list l2;
+        cfg_list_init(&l2);
+        if (l2_spec)
+        {
+            cfg_add_spec(&l2, l2_spec, block_size, mem_size);
+            if (l2.num_configs != 1 || l2.configs[0].mode == MODE_SC
+                || l2.configs[0].block_size != block_size
+                || l2.configs[0].cfg.inclusion != CACHE_NINE)
+            {
+                fprintf(stderr, "Error: --l2 must be a single nine dmc, fac"
+                                " or sac cache with the --block block"
+                                " size.\n");
+                exit(2);
             }
         }
-        
+        run_multicore((const char**) positional + 1, num_positional - 1,
+                      protocol, &l1, l2_spec ? &l2.configs[0] : 0, block_size,
+                      mem_size, quiet, dump_path, num_threads,
+                      epoch ? epoch : PMC_DEFAULT_EPOCH, exact, wb_entries,
+                      wb_batch);
+        free(l1.name);
+        cfg_list_free(&l2);
+        free(specs);
+        free(levels);
+        free(positional);
+        return 0;
+    }
+
+    if (num_specs == 0 && num_levels == 0 && num_positional == 2
+        && strcmp(positional[0], "sd") == 0)
+    {
+        if (ways || policy || event_log_path || dump_path || quiet || write
+            || alloc || wb_entries || prefetch || pf_degree || pf_distance
+            || victim || misscache || timed || profile_prefix
+            || set_ratio > 1 || period || mem_size != MAIN_MEMORY_SIZE
+            || mm_latency != HIERARCHY_MM_LATENCY || protocol_name || l2_spec
+            || num_threads || epoch || exact)
+        {
+            fprintf(stderr, "Error: sd only takes --sets and --block.\n");
+            exit(2);
+        }
+        if (sets > UINT_MAX)
+        {
+            fprintf(stderr, "Error: Too many sets or ways.\n");
+            exit(2);
+        }
+        analyze(positional[1], block_size, sets);
+        free(specs);
+        free(levels);
+        free(positional);
+        return 0;
     }
-    free(line);
+
+    if (num_levels)
+    {
+        if (num_positional != 1)
+            usage(argv[0]);
+        if (num_specs || sets || ways || policy || write || alloc || prefetch
+            || pf_degree || pf_distance || victim || misscache
+            || set_ratio > 1 || period || timed || profile_prefix)
+        {
+            fprintf(stderr, "Error: Give the geometry inside each --level;"
+                            " hierarchies take no --config, sampling,"
+                            " --timing or --profile.\n");
+            exit(2);
+        }
+        sim_config_list list;
+        cfg_list_init(&list);
+        unsigned int j;
+        for (j = 0; j < num_levels; j++)
+        {
+            cfg_add_spec(&list, levels[j], block_size, mem_size);
+            const sim_config* level = &list.configs[list.num_configs - 1];
+            if (list.num_configs != j + 1 || level->mode == MODE_SC
+                || level->block_size != block_size)
+            {
+                fprintf(stderr, "Error: Each --level must be a single dmc, fac"
+                                " or sac cache with the --block block size,"
+                                " got %s.\n", levels[j]);
+                exit(2);
+            }
+            // an exclusive level is filled only by whole blocks from above
+            if (j > 0 && level->cfg.inclusion == CACHE_EXCLUSIVE
+                && (level[-1].cfg.write_through
+                    || !level[-1].cfg.write_allocate))
+            {
+                fprintf(stderr, "Error: The level above an exclusive level"
+                                " must be write-back, write-allocate.\n");
+                exit(2);
+            }
+        }
+        if (access(positional[0], R_OK) != 0)
+        {
+            fprintf(stderr, "Error: Could not open %s.\n", positional[0]);
+            exit(3);
+        }
+        run_hierarchy(positional[0], &list, block_size, mem_size, mm_latency,
+                      quiet, event_log_path, dump_path, wb_entries, wb_batch);
+        cfg_list_free(&list);
+        free(specs);
+        free(levels);
+        free(positional);
+        return 0;
+    }
+
+    // Either one mode from the command line or a list of --config specs
+    sim_config_list list;
+    cfg_list_init(&list);
+    const char* trace_path;
+    if (num_specs == 0)
+    {
+        if (num_positional != 2)
+            usage(argv[0]);
+        list.configs = malloc(sizeof(sim_config));
+        list.num_configs = list.cap = 1;
+        cfg_make(positional[0], sets, ways, block_size, mem_size, policy,
+                 list.configs);
+        cfg_set_write_policy(list.configs, write, alloc);
+        cfg_set_prefetch(list.configs, prefetch, pf_degree, pf_distance);
+        cfg_set_victim(list.configs, victim, misscache);
+        trace_path = positional[1];
+    }
+    else
+    {
+        if (num_positional != 1)
+            usage(argv[0]);
+        if (sets || ways || policy || write || alloc || prefetch || pf_degree
+            || pf_distance || victim || misscache)
+        {
+            fprintf(stderr, "Error: Give the geometry, write policy,"
+                            " prefetcher and victim cache inside each"
+                            " --config.\n");
+            exit(2);
+        }
+        unsigned int j;
+        for (j = 0; j < num_specs; j++)
+            cfg_add_spec(&list, specs[j], block_size, mem_size);
+        if (list.num_configs > 1
+            && (event_log_path || dump_path || profile_prefix))
+        {
+            fprintf(stderr, "Error: --event-log, --dump-memory and --profile"
+                            " take a single configuration.\n");
+            exit(2);
+        }
+        trace_path = positional[0];
+    }
+    sim_config* configs = list.configs;
+    unsigned int num_configs = list.num_configs;
     
-    fclose(input_file);
+    int sampling = set_ratio > 1 || period;
+    if (sampling && (num_specs || configs[0].mode == MODE_SC
+                     || configs[0].cfg.prefetch
+                     || configs[0].cfg.victim_entries || timed
+                     || profile_prefix || event_log_path || dump_path))
+    {
+        fprintf(stderr, "Error: Sampling needs a single dmc, fac or sac"
+                        " cache and no prefetcher, victim cache, timing,"
+                        " profile, event log or memory dump.\n");
+        exit(2);
+    }
+    if (profile_prefix && configs[0].mode == MODE_SC)
+    {
+        fprintf(stderr, "Error: sc has no sets to profile.\n");
+        exit(2);
+    }
+    if (sampling && set_ratio > configs[0].cfg.num_sets)
+    {
+        fprintf(stderr, "Error: Cannot sample 1 in %zu of %u sets.\n",
+                set_ratio, configs[0].cfg.num_sets);
+        exit(2);
+    }
     
-    if (mode == MODE_SC)
+    if (access(trace_path, R_OK) != 0)
     {
-        print_stats(mm, sc->cs);
-        sc_free(sc);
+        fprintf(stderr, "Error: Could not open %s.\n", trace_path);
+        exit(3);
     }
-    else if (mode == MODE_DMC)
+    
+    // Every configuration gets its own copy-on-write mapping of the initial
+    // image, so untouched pages stay shared between them
+    size_t image_size;
+    int image_fd = mm_open_image(&image_size);
+    multi_sim* ms = ms_init(configs, num_configs, image_fd, image_size,
+                            mem_size);
+    close(image_fd);
+
+    // Interleaved per-access output of several caches would be unreadable
+    main_memory* mm = &ms->sims[0].mm;
+    unsigned int j;
+    for (j = 0; j < num_configs; j++)
     {
-        print_stats(mm, dmc->cs);
-        dmc_free(dmc);
+        ms->sims[j].mm.verbose = !quiet && num_configs == 1;
+        if (wb_entries)
+            mm_set_write_buffer(&ms->sims[j].mm, wb_entries, wb_batch);
     }
-    else if (mode == MODE_FAC)
+    if (profile_prefix)
     {
-        print_stats(mm, fac->cs);
-        fac_free(fac);
+        cache* c = &ms->sims[0].c;
+        c->profile = prof_init(c->num_sets, c->num_ways);
     }
-    else if (mode == MODE_SAC)
+    if (timed)
     {
-        print_stats(mm, sac->cs);
-        sac_free(sac);
+        timing_config tcfg;
+        tcfg.hit_latency = hit_latency ? hit_latency : TIMING_HIT_LATENCY;
+        tcfg.mm_latency = mm_latency;
+        tcfg.bus_cycles = bus_cycles ? bus_cycles : TIMING_BUS_CYCLES;
+        tcfg.num_mshrs = num_mshrs ? num_mshrs : TIMING_MSHRS;
+        for (j = 0; j < num_configs; j++)
+        {
+            // a word takes its share of a block's bus cycles, at least one
+            size_t block = ms->sims[j].mm.block_size;
+            tcfg.word_cycles = (tcfg.bus_cycles * sizeof(unsigned int)
+                                + block - 1) / block;
+            ms->sims[j].tm = timing_init(&tcfg);
+        }
     }
-    mm_free(mm);
+    if (event_log_path)
+    {
+        mm->log = el_open(event_log_path);
+        if (mm->log == 0)
+        {
+            fprintf(stderr, "Error: Could not create %s.\n", event_log_path);
+            exit(3);
+        }
+    }
+    
+    // Skipped accesses never reach the cache, so there is nothing to print
+    // per access
+    if (sampling)
+    {
+        mm->verbose = 0;
+        run_sampled(trace_path, &ms->sims[0], set_ratio, window, period,
+                    warmup);
+        ms_free(ms);
+        cfg_list_free(&list);
+        free(specs);
+        free(levels);
+        free(positional);
+        return 0;
+    }
+
+    // The trace is decoded once, a batch at a time, for all configurations.
+    // Verbose runs go one record at a time to keep format warnings next to
+    // the accesses around them.
+    trace_record batch[MULTI_SIM_BATCH];
+    size_t batch_cap = mm_tracing(mm) ? 1 : MULTI_SIM_BATCH;
+    size_t batch_len = 0;
+    trace_reader tr;
+    if (!tr_open(&tr, trace_path))
+        exit(3);
+    while (tr_next(&tr, &batch[batch_len]))
+    {
+        if (++batch_len == batch_cap)
+        {
+            ms_run(ms, batch, batch_len);
+            batch_len = 0;
+        }
+    }
+    tr_close(&tr);
+    ms_run(ms, batch, batch_len);
+    
+    for (j = 0; j < num_configs; j++)
+    {
+        sim_instance* sim = &ms->sims[j];
+        if (num_specs)
+            printf("Configuration: %s\n", configs[j].name);
+        if (sim->tm)
+            timing_finish(sim->tm);
+        if (sim->mode == MODE_SC)
+            print_stats(&sim->mm, sim->sc.cs, 0, sim->tm);
+        else
+            print_stats(&sim->mm, sim->c.cs, &sim->c, sim->tm);
+    }
+    if (mm->log)
+        el_close(mm->log);
+    if (dump_path)
+        dump_memory(&ms->sims[0], dump_path);
+    if (profile_prefix)
+        write_profile(&ms->sims[0].c, profile_prefix);
+    ms_free(ms);
+    cfg_list_free(&list);
+    free(specs);
+    free(levels);
+    free(positional);
     
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,19 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "main_memory.h"
 
-main_memory* mm_init()
+int mm_open_image(size_t* size)
 {
-    FILE* input_file = fopen(MAIN_MEMORY_INIT_FILE, "r");
-    if (input_file == 0)
+    int fd = open(MAIN_MEMORY_INIT_FILE, O_RDONLY);
+    if (fd < 0)
     {
         fprintf(stderr, "Error: Could not open %s."
                         " Ensure that file is in the proper directory.\n\n",
@@ -16,22 +21,130 @@ main_memory* mm_init()
         exit(1);
     }
 
+    struct stat st;
+    fstat(fd, &st);
+    *size = st.st_size;
+    return fd;
+}
+
+main_memory* mm_init(size_t size, size_t block_size)
+{
     main_memory* result = malloc(sizeof(main_memory));
+    size_t image_size;
+    int fd = mm_open_image(&image_size);
+    mm_setup(result, fd, image_size, size, block_size);
+    close(fd);
+    return result;
+}
 
-    result->data = malloc(MAIN_MEMORY_SIZE);
-    if (fread(result->data, MAIN_MEMORY_SIZE, 1, input_file) != 1)
+void mm_setup(main_memory* mm, int image_fd, size_t image_size, size_t size,
+              size_t block_size)
+{
+    assert(size <= MM_MAX_SIZE);
+    mm->size = size;
+    mm->block_size = block_size;
+    mm->w_queries = 0;
+    mm->r_queries = 0;
+    mm->w_words = 0;
+    mm->verbose = 1;
+    mm->log = 0;
+
+    // A private writable mapping shares the file's pages with every other
+    // mapping of it until a page is written, and reads pages in on demand
+    mm->image_size = image_size < size ? image_size : size;
+    mm->image = 0;
+    if (mm->image_size > 0)
     {
-        fprintf(stderr, "Error: Not enough data in %s.\n\n",
-                MAIN_MEMORY_INIT_FILE);
-        exit(2);
+        mm->image = mmap(0, mm->image_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, image_fd, 0);
+        if (mm->image == MAP_FAILED)
+        {
+            fprintf(stderr, "Error: Could not map %s.\n\n",
+                    MAIN_MEMORY_INIT_FILE);
+            exit(2);
+        }
     }
-    
-    fclose(input_file);
-    
-    result->w_queries = 0;
-    result->r_queries = 0;
 
-    return result;
+    mm->root = 0;
+    mm->num_pages = 0;
+    mm->last_page = UINTPTR_MAX;
+    mm->last_data = 0;
+    mm->wbuf = 0;
+}
+
+void mm_set_write_buffer(main_memory* mm, unsigned int num_entries,
+                         unsigned int batch)
+{
+    mm->wbuf = wb_init(num_entries, batch, mm->block_size);
+}
+
+// Returns the page with page number page. Pages of the image point into its
+// mapping; others are allocated zeroed on first touch.
+static unsigned char* mm_page(main_memory* mm, uintptr_t page)
+{
+    if (page == mm->last_page)
+        return mm->last_data;
+
+    void** slot = (void**) &mm->root;
+    int level;
+    for (level = MM_LEVELS - 1; level >= 0; level--)
+    {
+        if (*slot == 0)
+            *slot = calloc((size_t) 1 << MM_LEVEL_BITS, sizeof(void*));
+        void** node = *slot;
+        slot = &node[(page >> (level * MM_LEVEL_BITS))
+                     & (((size_t) 1 << MM_LEVEL_BITS) - 1)];
+    }
+
+    if (*slot == 0)
+    {
+        size_t start = page << MM_PAGE_BITS;
+        if (start < mm->image_size)
+        {
+            // the image mapping is zero past the end of the file, up to the
+            // end of its last page
+            *slot = mm->image + start;
+        }
+        else
+        {
+            *slot = calloc(1, MM_PAGE_SIZE);
+            ++mm->num_pages;
+        }
+    }
+
+    mm->last_page = page;
+    mm->last_data = *slot;
+    return mm->last_data;
+}
+
+// Copies size bytes at offset from/to memory, page by page
+static void mm_copy_out(main_memory* mm, size_t offset, void* dst, size_t size)
+{
+    unsigned char* out = dst;
+    while (size > 0)
+    {
+        size_t in_page = offset & (MM_PAGE_SIZE - 1);
+        size_t n = MM_PAGE_SIZE - in_page < size ? MM_PAGE_SIZE - in_page : size;
+        memcpy(out, mm_page(mm, offset >> MM_PAGE_BITS) + in_page, n);
+        out += n;
+        offset += n;
+        size -= n;
+    }
+}
+
+static void mm_copy_in(main_memory* mm, size_t offset, const void* src,
+                       size_t size)
+{
+    const unsigned char* in = src;
+    while (size > 0)
+    {
+        size_t in_page = offset & (MM_PAGE_SIZE - 1);
+        size_t n = MM_PAGE_SIZE - in_page < size ? MM_PAGE_SIZE - in_page : size;
+        memcpy(mm_page(mm, offset >> MM_PAGE_BITS) + in_page, in, n);
+        in += n;
+        offset += n;
+        size -= n;
+    }
 }
 
 void mm_write(main_memory* mm, void* start_addr, memory_block* mb)
@@ -39,46 +152,300 @@ void mm_write(main_memory* mm, void* start_addr, memory_block* mb)
     // start_addr argument must match mb argument's start_addr field
     assert(start_addr == mb->start_addr);
     
+    // the block we ask to write must have size mm->block_size
+    assert(mb->size == mm->block_size);
+    
+    mm_write_from(mm, start_addr, mb->data);
+}
+
+// Writes the stored bytes of the oldest entry of the write buffer to memory
+static void mm_drain_one(main_memory* mm, int count)
+{
+    write_buffer* wb = mm->wbuf;
+    int entry = wb_oldest(wb);
+    void* start_addr = wb->starts[entry];
+    size_t offset = (size_t) start_addr - MAIN_MEMORY_START_ADDR;
+    const unsigned char* data = wb_data(wb, entry);
+    const unsigned char* mask = wb_mask(wb, entry);
+    size_t written = 0;
+    size_t i = 0;
+    while (i < wb->block_size)
+    {
+        // copy each run of stored bytes
+        if (!mask[i])
+        {
+            ++i;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < wb->block_size && mask[end])
+            ++end;
+        mm_copy_in(mm, offset + i, data + i, end - i);
+        written += end - i;
+        i = end;
+    }
+    wb_pop(wb);
+
+    if (!count)
+        return;
+    if (mm_tracing(mm))
+        mm_trace(mm, EV_MM_WRITE, start_addr, written);
+    ++mm->w_queries;
+}
+
+// Puts size bytes at offset into the block starting at start_addr into the
+// write buffer, draining a batch first if a new entry does not fit
+static void mm_buffer(main_memory* mm, void* start_addr, size_t offset,
+                      const void* src, size_t size)
+{
+    write_buffer* wb = mm->wbuf;
+    ++wb->stores;
+    int entry = wb_find(wb, start_addr);
+    if (entry >= 0)
+        ++wb->merges;
+    else
+    {
+        if (wb->count == wb->num_entries)
+        {
+            unsigned int i;
+            for (i = 0; i < wb->batch; i++)
+                mm_drain_one(mm, 1);
+        }
+        entry = wb_push(wb, start_addr);
+    }
+    memcpy(wb_data(wb, entry) + offset, src, size);
+    memset(wb_mask(wb, entry) + offset, 1, size);
+}
+
+void mm_write_from(main_memory* mm, void* start_addr, const void* src)
+{
     // the block we ask to write must be aligned to a MAIN_MEMORY block
     assert((size_t) (start_addr - MAIN_MEMORY_START_ADDR)
-           % MAIN_MEMORY_BLOCK_SIZE == 0);
-    
-    // the block we ask to write must have size MAIN_MEMORY_BLOCK_SIZE
-    assert(mb->size == MAIN_MEMORY_BLOCK_SIZE);
-    
+           % mm->block_size == 0);
+
     // make sure we are not out of bounds
     assert(start_addr >= MAIN_MEMORY_START_ADDR);
-    assert(start_addr + mb->size
-           <= (void*) MAIN_MEMORY_START_ADDR + MAIN_MEMORY_SIZE);
-    
-    memcpy(mm->data + (size_t) start_addr - MAIN_MEMORY_START_ADDR, mb->data, mb->size);
-    
-    printf("MM: Wrote %zu bytes at %p.\n", mb->size, start_addr);
+    assert(start_addr + mm->block_size
+           <= (void*) MAIN_MEMORY_START_ADDR + mm->size);
+
+    if (mm->wbuf)
+    {
+        mm_buffer(mm, start_addr, 0, src, mm->block_size);
+        return;
+    }
+
+    mm_copy_in(mm, (size_t) start_addr - MAIN_MEMORY_START_ADDR, src,
+               mm->block_size);
+
+    if (mm_tracing(mm))
+        mm_trace(mm, EV_MM_WRITE, start_addr, mm->block_size);
     ++mm->w_queries;
 }
 
-memory_block* mm_read(main_memory* mm, void* start_addr)
+void mm_write_word(main_memory* mm, void* addr, unsigned int val)
+{
+    // make sure we are not out of bounds
+    assert(addr >= MAIN_MEMORY_START_ADDR);
+    assert(addr + sizeof(unsigned int)
+           <= (void*) MAIN_MEMORY_START_ADDR + mm->size);
+
+    size_t offset = (size_t) addr - MAIN_MEMORY_START_ADDR;
+    if (mm->wbuf)
+    {
+        size_t in_block = offset % mm->block_size;
+        mm_buffer(mm, addr - in_block, in_block, &val, sizeof(unsigned int));
+        return;
+    }
+
+    mm_copy_in(mm, offset, &val, sizeof(unsigned int));
+
+    if (mm_tracing(mm))
+        mm_trace(mm, EV_MM_WRITE, addr, sizeof(unsigned int));
+    ++mm->w_queries;
+    ++mm->w_words;
+}
+
+void mm_read_into(main_memory* mm, void* start_addr, void* dst)
 {
     // the block we ask to read must be aligned to a MAIN_MEMORY block
     assert((size_t) (start_addr - MAIN_MEMORY_START_ADDR)
-           % MAIN_MEMORY_BLOCK_SIZE == 0);
-    
+           % mm->block_size == 0);
+
     // make sure we are not out of bounds
-    assert(start_addr + MAIN_MEMORY_BLOCK_SIZE <=
-           (void*) MAIN_MEMORY_START_ADDR + MAIN_MEMORY_SIZE);
-    
-    memory_block* result
-        = mb_new(start_addr, MAIN_MEMORY_BLOCK_SIZE,
-                 mm->data + (size_t) start_addr - MAIN_MEMORY_START_ADDR);
-        
-    printf("MM: Read %zu bytes at %p.\n", result->size, start_addr);
+    assert(start_addr + mm->block_size <=
+           (void*) MAIN_MEMORY_START_ADDR + mm->size);
+
+    // a block the write buffer holds entirely never reaches memory
+    int entry = mm->wbuf ? wb_find(mm->wbuf, start_addr) : -1;
+    if (entry >= 0 && wb_covers(mm->wbuf, entry))
+    {
+        memcpy(dst, wb_data(mm->wbuf, entry), mm->block_size);
+        return;
+    }
+
+    mm_copy_out(mm, (size_t) start_addr - MAIN_MEMORY_START_ADDR, dst,
+                mm->block_size);
+
+    if (entry >= 0)
+    {
+        // the buffered bytes are newer
+        unsigned char* out = dst;
+        const unsigned char* data = wb_data(mm->wbuf, entry);
+        const unsigned char* mask = wb_mask(mm->wbuf, entry);
+        size_t i;
+        for (i = 0; i < mm->block_size; i++)
+        {
+            if (mask[i])
+                out[i] = data[i];
+        }
+    }
+
+    if (mm_tracing(mm))
+        mm_trace(mm, EV_MM_READ, start_addr, mm->block_size);
     ++mm->r_queries;
-    
+}
+
+memory_block* mm_read(main_memory* mm, void* start_addr)
+{
+    unsigned char* block = malloc(mm->block_size);
+    mm_read_into(mm, start_addr, block);
+    memory_block* result = mb_new(start_addr, mm->block_size, block);
+    free(block);
     return result;
 }
 
+static void level_read(void* self, void* start_addr, void* dst, int* dirty)
+{
+    mm_read_into(self, start_addr, dst);
+    *dirty = 0;
+}
+
+static void level_write(void* self, void* start_addr, const void* src,
+                        int dirty)
+{
+    mm_write_from(self, start_addr, src);
+}
+
+static void level_write_word(void* self, void* addr, unsigned int val)
+{
+    mm_write_word(self, addr, val);
+}
+
+mem_level mm_level(main_memory* mm)
+{
+    mem_level result = { mm, level_read, level_write, level_write_word, 0 };
+    return result;
+}
+
+void mm_trace(main_memory* mm, uint8_t kind, void* addr, unsigned int val)
+{
+    if (mm->verbose)
+    {
+        if (kind == EV_MM_READ)
+            printf("MM: Read %zu bytes at %p.\n", (size_t) val, addr);
+        else if (kind == EV_MM_WRITE)
+            printf("MM: Wrote %zu bytes at %p.\n", (size_t) val, addr);
+        else if (kind == EV_STORE)
+            printf("Wrote to %p: %d\n\n", addr, val);
+        else
+            printf("Read from %p: %d\n\n", addr, val);
+    }
+    if (mm->log)
+        el_append(mm->log, kind, addr, val);
+}
+
+typedef void (*mm_page_fn)(main_memory* mm, uintptr_t page, void* data,
+                           void* arg);
+
+// Calls fn on every allocated page under node, level levels above the pages,
+// that is not part of the image mapping; page is the first page of node
+static void mm_walk(main_memory* mm, void** node, int level, uintptr_t page,
+                    mm_page_fn fn, void* arg)
+{
+    if (node == 0)
+        return;
+    if (level == 0)
+    {
+        if ((page << MM_PAGE_BITS) >= mm->image_size)
+            fn(mm, page, node, arg);
+        return;
+    }
+    size_t i;
+    for (i = 0; i < (size_t) 1 << MM_LEVEL_BITS; i++)
+    {
+        mm_walk(mm, node[i], level - 1,
+                page | i << ((level - 1) * MM_LEVEL_BITS), fn, arg);
+    }
+}
+
+// Frees the nodes of the subtree under node, but not its pages
+static void mm_free_nodes(void** node, int level)
+{
+    if (node == 0)
+        return;
+    if (level > 1)
+    {
+        size_t i;
+        for (i = 0; i < (size_t) 1 << MM_LEVEL_BITS; i++)
+            mm_free_nodes(node[i], level - 1);
+    }
+    free(node);
+}
+
+static void mm_free_page(main_memory* mm, uintptr_t page, void* data,
+                         void* arg)
+{
+    free(data);
+}
+
+// Writes a page to the file descriptor pointed to by arg
+static void mm_dump_page(main_memory* mm, uintptr_t page, void* data,
+                         void* arg)
+{
+    int* fd = arg;
+    size_t start = page << MM_PAGE_BITS;
+    size_t size = mm->size - start < MM_PAGE_SIZE ? mm->size - start
+                                                  : MM_PAGE_SIZE;
+    if (*fd >= 0 && pwrite(*fd, data, size, start) != (ssize_t) size)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+int mm_dump(main_memory* mm, const char* path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return 0;
+    while (mm->wbuf && mm->wbuf->count > 0)
+        mm_drain_one(mm, 0);
+
+    // untouched pages past the image are zero, so leave them as holes
+    if (ftruncate(fd, mm->size) != 0
+        || (mm->image_size > 0
+            && pwrite(fd, mm->image, mm->image_size, 0)
+               != (ssize_t) mm->image_size))
+    {
+        close(fd);
+        return 0;
+    }
+    mm_walk(mm, mm->root, MM_LEVELS, 0, mm_dump_page, &fd);
+    return fd >= 0 && close(fd) == 0;
+}
+
+void mm_release(main_memory* mm)
+{
+    mm_walk(mm, mm->root, MM_LEVELS, 0, mm_free_page, 0);
+    mm_free_nodes(mm->root, MM_LEVELS);
+    if (mm->wbuf)
+        wb_free(mm->wbuf);
+    if (mm->image_size > 0)
+        munmap(mm->image, mm->image_size);
+}
+
 void mm_free(main_memory* mm)
 {
-    free(mm->data);
+    mm_release(mm);
     free(mm);
 }
\ No newline at end of file
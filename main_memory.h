@@ -2,6 +2,9 @@
 #define MAIN_MEMORY_H
 
 #include "memory_block.h"
+#include "event_log.h"
+#include "mem_level.h"
+#include "write_buffer.h"
 
 #define MAIN_MEMORY_SIZE 65536
 #define MAIN_MEMORY_SIZE_LN 16
@@ -10,19 +13,100 @@
 #define MAIN_MEMORY_BLOCK_SIZE_LN 5
 #define MAIN_MEMORY_INIT_FILE "mm_init.data"
 
+// Memory is stored sparsely in pages of MM_PAGE_SIZE bytes, found through a
+// radix tree of MM_LEVELS levels indexed by MM_LEVEL_BITS bits of the page
+// number each. Pages inside the init image point into a private
+// copy-on-write mapping of MAIN_MEMORY_INIT_FILE, so they are read in on
+// first touch, shared with every other memory until written and never
+// copied up front; pages past its end are allocated zeroed on first touch.
+// Memory use follows the touched footprint and the address space can reach
+// MM_MAX_SIZE bytes.
+#define MM_PAGE_BITS 12
+#define MM_PAGE_SIZE ((size_t) 1 << MM_PAGE_BITS)
+#define MM_LEVEL_BITS 12
+#define MM_LEVELS 3
+#define MM_MAX_SIZE ((size_t) 1 << (MM_PAGE_BITS + MM_LEVELS * MM_LEVEL_BITS))
+
 typedef struct main_memory
 {
-    void* data;
+    size_t size;            // bytes of memory, MAIN_MEMORY_SIZE by default
+    size_t block_size;      // bytes per block, MAIN_MEMORY_BLOCK_SIZE by default
     unsigned int w_queries;
     unsigned int r_queries;
+    unsigned int w_words;   // of w_queries, single words written unbuffered
+    int verbose;            // print a line per access, on by default
+    event_log* log;         // binary per-access log, 0 when off
+
+    // Private mapping of the initial contents; memory past image_size
+    // starts out zero
+    unsigned char* image;
+    size_t image_size;
+
+    void** root;            // radix tree of pages
+    size_t num_pages;       // pages allocated so far
+    uintptr_t last_page;    // page number of last_data, for repeated hits
+    unsigned char* last_data;
+
+    // Coalescing buffer in front of memory, 0 when off. Writes land in it
+    // and only count in w_queries when they drain.
+    write_buffer* wbuf;
 } main_memory;
 
-main_memory* mm_init();
+// Whether per-access events have anywhere to go. Building with
+// -DCACHE_SIM_NO_TRACE compiles the per-access trace out entirely.
+#ifdef CACHE_SIM_NO_TRACE
+#define mm_tracing(mm) 0
+#else
+#define mm_tracing(mm) ((mm)->verbose || (mm)->log)
+#endif
+
+// Reports an EV_* event on stdout and/or to the event log. Callers check
+// mm_tracing first so quiet runs skip the call.
+void mm_trace(main_memory* mm, uint8_t kind, void* addr, unsigned int val);
+
+// Maps MAIN_MEMORY_INIT_FILE as the initial contents of a size byte memory;
+// all reads and writes then move whole blocks of block_size bytes
+main_memory* mm_init(size_t size, size_t block_size);
+
+// Opens MAIN_MEMORY_INIT_FILE, for setting up several memories over it.
+// Sets *size to its length and returns the descriptor; the caller closes it.
+int mm_open_image(size_t* size);
+
+// Same as mm_init, but in caller-owned storage and over an image opened by
+// mm_open_image, which may be closed once this returns; undone by mm_release
+void mm_setup(main_memory* mm, int image_fd, size_t image_size, size_t size,
+              size_t block_size);
 
 void mm_write(main_memory* mm, void* start_addr, memory_block* mb);
 
 memory_block* mm_read(main_memory* mm, void* start_addr);
 
+// Same as mm_write/mm_read, but copy the block from/to caller-owned storage
+// instead of going through a memory_block
+void mm_write_from(main_memory* mm, void* start_addr, const void* src);
+
+void mm_read_into(main_memory* mm, void* start_addr, void* dst);
+
+// Writes a single word, as stored through or around a cache
+void mm_write_word(main_memory* mm, void* addr, unsigned int val);
+
+// Puts a write buffer of num_entries blocks in front of mm. When it is
+// full, the oldest batch entries drain to memory, one write each. Reads
+// take the newest bytes from the buffer, and a read of a block the buffer
+// holds entirely does not reach memory.
+void mm_set_write_buffer(main_memory* mm, unsigned int num_entries,
+                         unsigned int batch);
+
+// mm as the level below a cache
+mem_level mm_level(main_memory* mm);
+
+// Writes the current contents of memory to path, as a file of mm->size bytes
+// in the format of MAIN_MEMORY_INIT_FILE, after draining the write buffer.
+// Queries are not counted. Returns 0 on failure with errno set.
+int mm_dump(main_memory* mm, const char* path);
+
+void mm_release(main_memory* mm);
+
 void mm_free(main_memory* mm);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef MEM_LEVEL_H
+#define MEM_LEVEL_H
+
+// The level of the memory hierarchy below a cache: another cache or main
+// memory. Blocks move between levels by copying straight into and out of
+// the callers' line storage, one block of the shared block size at a time.
+typedef struct mem_level
+{
+    void* self;
+
+    // Copies the block starting at start_addr into dst. Sets *dirty if the
+    // block left this level still dirty, which only an exclusive cache does.
+    void (*read)(void* self, void* start_addr, void* dst, int* dirty);
+
+    // Takes a block evicted from the level above
+    void (*write)(void* self, void* start_addr, const void* src, int dirty);
+
+    // Takes a single word stored through or around the level above, by a
+    // write-through or no-write-allocate cache
+    void (*write_word)(void* self, void* addr, unsigned int val);
+
+    // 1 if clean evicted blocks are passed down too, not just dirty ones
+    int takes_clean;
+} mem_level;
+
+#endif
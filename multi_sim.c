@@ -0,0 +1,142 @@
+#include <stdlib.h>
+
+#include "multi_sim.h"
+
+multi_sim* ms_init(const sim_config* configs, unsigned int num_configs,
+                   int image_fd, size_t image_size, size_t mem_size)
+{
+    multi_sim* result = malloc(sizeof(multi_sim));
+    result->num_sims = num_configs;
+    result->sims = malloc(num_configs * sizeof(sim_instance));
+
+    unsigned int i;
+    for (i = 0; i < num_configs; i++)
+    {
+        sim_instance* sim = &result->sims[i];
+        sim->mode = configs[i].mode;
+        sim->tm = 0;
+
+        mm_setup(&sim->mm, image_fd, image_size, mem_size,
+                 configs[i].block_size);
+
+        if (sim->mode == MODE_SC)
+            sc_setup(&sim->sc, &sim->mm);
+        else
+            cache_setup(&sim->c, &sim->mm, &configs[i].cfg);
+    }
+    return result;
+}
+
+static void run_simple(sim_instance* sim, const trace_record* records,
+                       size_t num_records)
+{
+    size_t i;
+    for (i = 0; i < num_records; i++)
+    {
+        void* addr = (void*) records[i].addr;
+        unsigned int val = records[i].val;
+        if (records[i].op == TRACE_WRITE)
+        {
+            sc_store_word(&sim->sc, addr, val);
+            if (mm_tracing(&sim->mm))
+                mm_trace(&sim->mm, EV_STORE, addr, val);
+        }
+        else
+        {
+            val = sc_load_word(&sim->sc, addr);
+            if (mm_tracing(&sim->mm))
+                mm_trace(&sim->mm, EV_LOAD, addr, val);
+        }
+    }
+}
+
+static void run_cache(sim_instance* sim, const trace_record* records,
+                      size_t num_records)
+{
+    // the trace reports each access after the transfers it made, so only
+    // quiet runs take the batch path
+    if (!mm_tracing(&sim->mm))
+    {
+        cache_access_batch(&sim->c, records, num_records, 0);
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < num_records; i++)
+    {
+        void* addr = (void*) records[i].addr;
+        unsigned int val = records[i].val;
+        if (records[i].op == TRACE_WRITE)
+        {
+            cache_store_word(&sim->c, addr, val);
+            if (mm_tracing(&sim->mm))
+                mm_trace(&sim->mm, EV_STORE, addr, val);
+        }
+        else
+        {
+            val = cache_load_word(&sim->c, addr);
+            if (mm_tracing(&sim->mm))
+                mm_trace(&sim->mm, EV_LOAD, addr, val);
+        }
+    }
+}
+
+// Runs the records one at a time, timing each by the main memory traffic
+// it made
+static void run_timed(sim_instance* sim, const trace_record* records,
+                      size_t num_records)
+{
+    size_t i;
+    for (i = 0; i < num_records; i++)
+    {
+        unsigned int reads = sim->mm.r_queries;
+        unsigned int writes = sim->mm.w_queries;
+        unsigned int words = sim->mm.w_words;
+        unsigned int pf_reads = 0;
+        if (sim->mode == MODE_SC)
+            run_simple(sim, &records[i], 1);
+        else
+        {
+            pf_reads = cache_pf_reads_below(&sim->c);
+            run_cache(sim, &records[i], 1);
+            pf_reads = cache_pf_reads_below(&sim->c) - pf_reads;
+        }
+        words = sim->mm.w_words - words;
+        timing_access(sim->tm, records[i].addr / sim->mm.block_size,
+                      sim->mm.r_queries - reads - pf_reads, pf_reads,
+                      sim->mm.w_queries - writes - words, words);
+    }
+}
+
+void ms_run(multi_sim* ms, const trace_record* records, size_t num_records)
+{
+    unsigned int i;
+    for (i = 0; i < ms->num_sims; i++)
+    {
+        sim_instance* sim = &ms->sims[i];
+        if (sim->tm)
+            run_timed(sim, records, num_records);
+        else if (sim->mode == MODE_SC)
+            run_simple(sim, records, num_records);
+        else
+            run_cache(sim, records, num_records);
+    }
+}
+
+void ms_free(multi_sim* ms)
+{
+    unsigned int i;
+    for (i = 0; i < ms->num_sims; i++)
+    {
+        sim_instance* sim = &ms->sims[i];
+        if (sim->mode == MODE_SC)
+            sc_release(&sim->sc);
+        else
+            cache_release(&sim->c);
+        mm_release(&sim->mm);
+        if (sim->tm)
+            timing_free(sim->tm);
+    }
+    free(ms->sims);
+    free(ms);
+}
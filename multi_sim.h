@@ -0,0 +1,47 @@
+#ifndef MULTI_SIM_H
+#define MULTI_SIM_H
+
+#include "main_memory.h"
+#include "simple.h"
+#include "cache.h"
+#include "trace.h"
+#include "sim_config.h"
+#include "timing.h"
+
+// Records decoded ahead and run through every simulation in turn, so each
+// cache's state stays hot over a whole batch
+#define MULTI_SIM_BATCH 256
+
+// A simulated cache with its own shadow of main memory, and its timing if
+// tm is not 0
+typedef struct sim_instance
+{
+    int mode;
+    main_memory mm;
+    timing* tm;
+    union
+    {
+        simple_cache sc;
+        cache c;
+    };
+} sim_instance;
+
+// Several simulations fed from the same trace. The instances live in one
+// array so fanning an access out to all of them walks contiguous memory.
+typedef struct multi_sim
+{
+    unsigned int num_sims;
+    sim_instance* sims;
+} multi_sim;
+
+// Sets up one instance per config, each with its own mem_size byte memory
+// over the image opened by mm_open_image
+multi_sim* ms_init(const sim_config* configs, unsigned int num_configs,
+                   int image_fd, size_t image_size, size_t mem_size);
+
+// Runs num_records accesses through every instance
+void ms_run(multi_sim* ms, const trace_record* records, size_t num_records);
+
+void ms_free(multi_sim* ms);
+
+#endif
@@ -0,0 +1,409 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "parallel_mc.h"
+
+// Initial slots of a partition's block table
+#define PMC_MIN_TABLE 1024
+
+// Marks a block touched by more than one core in a block table
+#define PMC_SHARED -1
+
+// A block touched by core in the epoch, at its records[index]
+typedef struct pmc_item
+{
+    uintptr_t block;
+    unsigned int core;
+    unsigned int index;
+} pmc_item;
+
+typedef struct pmc_items
+{
+    pmc_item* items;
+    size_t num;
+    size_t cap;
+} pmc_items;
+
+// One core's part of the current epoch
+typedef struct pmc_core
+{
+    trace_reader* reader;
+    trace_record* records;
+    unsigned char* shared;  // per record: another core touches the block
+    unsigned int num_records;
+    unsigned int pos;       // next record to run
+    int stale;              // may have hits to run: new epoch, or the
+                            // serial step ran some of its records
+    int ended;
+} pmc_core;
+
+typedef struct pmc_sim
+{
+    coh_system* sys;
+    pmc_core* cores;
+    unsigned int num_threads;
+    unsigned int epoch;
+    int exact;
+
+    pthread_barrier_t barrier;
+    atomic_uint next_core;  // cores handed out in a parallel step
+    atomic_uint loaded;     // records of the epoch, over all cores
+
+    // Exact mode sorts the blocks of an epoch into one partition per thread:
+    // items[t * num_threads + p] holds those thread t read for partition p,
+    // and thread p finds the shared ones in its table, from block + 1 to the
+    // core touching it or PMC_SHARED
+    pmc_items* items;
+    uintptr_t** keys;
+    int** owners;
+    size_t* caps;
+
+    // Serial step: the turn to go on from, and the blocked cores in turn
+    // order, as position << 32 | core
+    unsigned int round;
+    unsigned int turn;
+    uint64_t* blocked;
+    int epoch_done;
+} pmc_sim;
+
+typedef struct pmc_worker
+{
+    pmc_sim* sim;
+    unsigned int id;
+} pmc_worker;
+
+static inline uint64_t block_hash(uintptr_t block)
+{
+    return (uint64_t) (block + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+static void items_push(pmc_items* list, uintptr_t block, unsigned int core,
+                       unsigned int index)
+{
+    if (list->num == list->cap)
+    {
+        list->cap = list->cap ? 2 * list->cap : 256;
+        list->items = realloc(list->items, list->cap * sizeof(pmc_item));
+    }
+    pmc_item* item = &list->items[list->num++];
+    item->block = block;
+    item->core = core;
+    item->index = index;
+}
+
+// Reads the next epoch of the cores of thread id, and in exact mode sorts
+// their blocks into partitions
+static void load_epoch(pmc_sim* sim, unsigned int id)
+{
+    unsigned int num_threads = sim->num_threads;
+    unsigned int p;
+    for (p = 0; p < num_threads; p++)
+        sim->items[id * num_threads + p].num = 0;
+
+    const addr_layout* layout = &sim->sys->cores[0].l1.layout;
+    unsigned int loaded = 0;
+    unsigned int c;
+    for (c = id; c < sim->sys->num_cores; c += num_threads)
+    {
+        pmc_core* core = &sim->cores[c];
+        core->num_records = 0;
+        core->pos = 0;
+        core->stale = 1;
+        while (!core->ended && core->num_records < sim->epoch)
+        {
+            if (!tr_next(core->reader, &core->records[core->num_records]))
+                core->ended = 1;
+            else
+                ++core->num_records;
+        }
+        loaded += core->num_records;
+        if (!sim->exact)
+            continue;
+
+        unsigned int i;
+        for (i = 0; i < core->num_records; i++)
+        {
+            addr_parts parts;
+            addr_split(layout, (void*) core->records[i].addr, layout->pow2,
+                       &parts);
+            p = (block_hash(parts.block) >> 32) % num_threads;
+            items_push(&sim->items[id * num_threads + p], parts.block, c, i);
+        }
+    }
+    atomic_fetch_add(&sim->loaded, loaded);
+}
+
+// Finds the blocks of partition p that more than one core touches in the
+// epoch and flags their records
+static void mark_shared(pmc_sim* sim, unsigned int p)
+{
+    unsigned int num_threads = sim->num_threads;
+    size_t total = 0;
+    unsigned int t;
+    for (t = 0; t < num_threads; t++)
+        total += sim->items[t * num_threads + p].num;
+
+    size_t cap = sim->caps[p];
+    while (cap < 2 * total)
+        cap *= 2;
+    if (cap != sim->caps[p])
+    {
+        sim->caps[p] = cap;
+        sim->keys[p] = realloc(sim->keys[p], cap * sizeof(uintptr_t));
+        sim->owners[p] = realloc(sim->owners[p], cap * sizeof(int));
+    }
+    uintptr_t* keys = sim->keys[p];
+    int* owners = sim->owners[p];
+    memset(keys, 0, cap * sizeof(uintptr_t));
+
+    // first pass: who touches each block; second: flag the records
+    int pass;
+    for (pass = 0; pass < 2; pass++)
+    for (t = 0; t < num_threads; t++)
+    {
+        const pmc_items* list = &sim->items[t * num_threads + p];
+        size_t i;
+        for (i = 0; i < list->num; i++)
+        {
+            const pmc_item* item = &list->items[i];
+            uintptr_t key = item->block + 1;
+            size_t slot = (block_hash(item->block) >> 17) & (cap - 1);
+            while (keys[slot] != 0 && keys[slot] != key)
+                slot = (slot + 1) & (cap - 1);
+            if (pass == 1)
+                sim->cores[item->core].shared[item->index]
+                    = owners[slot] == PMC_SHARED;
+            else if (keys[slot] == 0)
+            {
+                keys[slot] = key;
+                owners[slot] = item->core;
+            }
+            else if (owners[slot] != (int) item->core)
+                owners[slot] = PMC_SHARED;
+        }
+    }
+}
+
+// Parallel step: each core runs its hits until the first access that needs
+// the directory, or in exact mode that touches a shared block. Cores the
+// serial step left alone are still blocked where they were.
+static void run_local(pmc_sim* sim)
+{
+    unsigned int c;
+    while ((c = atomic_fetch_add(&sim->next_core, 1)) < sim->sys->num_cores)
+    {
+        pmc_core* core = &sim->cores[c];
+        if (!core->stale)
+            continue;
+        core->stale = 0;
+        while (core->pos < core->num_records
+               && !(sim->exact && core->shared[core->pos]))
+        {
+            const trace_record* r = &core->records[core->pos];
+            unsigned int val = r->val;
+            if (!coh_try_local(sim->sys, c, (void*) r->addr,
+                               r->op == TRACE_WRITE, &val))
+                break;
+            ++core->pos;
+        }
+    }
+}
+
+static void run_record(coh_system* sys, unsigned int c, const trace_record* r)
+{
+    if (r->op == TRACE_WRITE)
+        coh_store_word(sys, c, (void*) r->addr, r->val);
+    else
+        coh_load_word(sys, c, (void*) r->addr);
+}
+
+// Exact serial step: runs the records left in the turn order from where the
+// last one stopped. Gives the rest back to a parallel step at the next
+// record that may run there, once num_threads cores have records run here.
+// Returns 1 at the end of the epoch.
+static int run_in_order(pmc_sim* sim)
+{
+    unsigned int num_cores = sim->sys->num_cores;
+    unsigned int stale = 0;
+    for (; sim->round < sim->epoch; sim->round++, sim->turn = 0)
+    {
+        for (; sim->turn < num_cores; sim->turn++)
+        {
+            pmc_core* core = &sim->cores[sim->turn];
+            if (core->pos != sim->round || core->pos >= core->num_records)
+                continue;
+            if (!core->shared[core->pos] && stale >= sim->num_threads)
+                return 0;
+            run_record(sim->sys, sim->turn, &core->records[core->pos]);
+            ++core->pos;
+            if (!core->stale)
+            {
+                core->stale = 1;
+                ++stale;
+            }
+        }
+    }
+    return 1;
+}
+
+static int by_turn(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Bounded-slack serial step: runs the access every blocked core is waiting
+// on, in turn order. Returns 1 at the end of the epoch.
+static int run_blocked(pmc_sim* sim)
+{
+    unsigned int num_blocked = 0;
+    unsigned int c;
+    for (c = 0; c < sim->sys->num_cores; c++)
+    {
+        const pmc_core* core = &sim->cores[c];
+        if (core->pos < core->num_records)
+            sim->blocked[num_blocked++] = (uint64_t) core->pos << 32 | c;
+    }
+    if (num_blocked == 0)
+        return 1;
+    qsort(sim->blocked, num_blocked, sizeof(uint64_t), by_turn);
+
+    unsigned int i;
+    for (i = 0; i < num_blocked; i++)
+    {
+        pmc_core* core = &sim->cores[(uint32_t) sim->blocked[i]];
+        run_record(sim->sys, (uint32_t) sim->blocked[i],
+                   &core->records[core->pos]);
+        ++core->pos;
+        core->stale = 1;
+    }
+    return 0;
+}
+
+static void* worker_main(void* arg)
+{
+    pmc_worker* w = arg;
+    pmc_sim* sim = w->sim;
+    for (;;)
+    {
+        load_epoch(sim, w->id);
+        pthread_barrier_wait(&sim->barrier);
+        if (atomic_load(&sim->loaded) == 0)
+            return 0;
+        if (sim->exact)
+        {
+            mark_shared(sim, w->id);
+            pthread_barrier_wait(&sim->barrier);
+        }
+
+        do
+        {
+            run_local(sim);
+            pthread_barrier_wait(&sim->barrier);
+            if (w->id == 0)
+            {
+                sim->epoch_done = sim->exact ? run_in_order(sim)
+                                             : run_blocked(sim);
+                atomic_store(&sim->next_core, 0);
+                if (sim->epoch_done)
+                {
+                    atomic_store(&sim->loaded, 0);
+                    sim->round = 0;
+                    sim->turn = 0;
+                }
+            }
+            pthread_barrier_wait(&sim->barrier);
+        } while (!sim->epoch_done);
+    }
+}
+
+void pmc_run(coh_system* sys, trace_reader* readers, unsigned int num_threads,
+             unsigned int epoch, int exact)
+{
+    unsigned int num_cores = sys->num_cores;
+    if (num_threads > num_cores)
+        num_threads = num_cores;
+
+    pmc_sim sim;
+    sim.sys = sys;
+    sim.num_threads = num_threads;
+    sim.epoch = epoch;
+    sim.exact = exact;
+    pthread_barrier_init(&sim.barrier, 0, num_threads);
+    atomic_init(&sim.next_core, 0);
+    atomic_init(&sim.loaded, 0);
+    sim.round = 0;
+    sim.turn = 0;
+    sim.epoch_done = 0;
+    sim.blocked = malloc(num_cores * sizeof(uint64_t));
+
+    sim.cores = malloc(num_cores * sizeof(pmc_core));
+    unsigned int i;
+    for (i = 0; i < num_cores; i++)
+    {
+        pmc_core* core = &sim.cores[i];
+        core->reader = &readers[i];
+        core->records = malloc(epoch * sizeof(trace_record));
+        core->shared = exact ? malloc(epoch) : 0;
+        core->num_records = 0;
+        core->pos = 0;
+        core->stale = 0;
+        core->ended = 0;
+    }
+
+    sim.items = calloc(num_threads * num_threads, sizeof(pmc_items));
+    sim.keys = malloc(num_threads * sizeof(uintptr_t*));
+    sim.owners = malloc(num_threads * sizeof(int*));
+    sim.caps = malloc(num_threads * sizeof(size_t));
+    for (i = 0; i < num_threads; i++)
+    {
+        sim.caps[i] = PMC_MIN_TABLE;
+        sim.keys[i] = exact ? malloc(PMC_MIN_TABLE * sizeof(uintptr_t)) : 0;
+        sim.owners[i] = exact ? malloc(PMC_MIN_TABLE * sizeof(int)) : 0;
+    }
+
+    // this thread is worker 0 and runs the serial steps
+    pmc_worker* workers = malloc(num_threads * sizeof(pmc_worker));
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    for (i = 0; i < num_threads; i++)
+    {
+        workers[i].sim = &sim;
+        workers[i].id = i;
+        if (i > 0 && pthread_create(&threads[i], 0, worker_main,
+                                    &workers[i]) != 0)
+        {
+            fprintf(stderr, "Error: Could not start thread %u.\n", i);
+            exit(4);
+        }
+    }
+    worker_main(&workers[0]);
+    for (i = 1; i < num_threads; i++)
+        pthread_join(threads[i], 0);
+
+    for (i = 0; i < num_cores; i++)
+    {
+        free(sim.cores[i].records);
+        free(sim.cores[i].shared);
+    }
+    for (i = 0; i < num_threads * num_threads; i++)
+        free(sim.items[i].items);
+    for (i = 0; i < num_threads; i++)
+    {
+        free(sim.keys[i]);
+        free(sim.owners[i]);
+    }
+    pthread_barrier_destroy(&sim.barrier);
+    free(sim.items);
+    free(sim.keys);
+    free(sim.owners);
+    free(sim.caps);
+    free(sim.blocked);
+    free(sim.cores);
+    free(workers);
+    free(threads);
+}
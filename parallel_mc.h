@@ -0,0 +1,26 @@
+#ifndef PARALLEL_MC_H
+#define PARALLEL_MC_H
+
+#include "coherence.h"
+#include "trace.h"
+
+// Rounds of the turn order taken per epoch, by default
+#define PMC_DEFAULT_EPOCH 1024
+
+// Runs the trace of readers[i] on core i of sys, like the serial turn order
+// of one access per core, on num_threads threads. The traces are taken an
+// epoch of epoch rounds at a time. In parallel steps every core runs the
+// accesses that only touch its own cache, hits with the permission they
+// need, on whichever thread is free; in the serial steps between them one
+// thread runs the accesses that need the directory.
+//
+// With exact set, only hits on blocks no other core touches in the epoch
+// run in parallel and everything else runs in the serial turn order, so the
+// results are the same as those of a serial run. Otherwise a core's hits
+// may run ahead of other cores' misses by up to the rest of the epoch, and
+// each serial step runs the next access of every core that is blocked, in
+// turn order. Both are reproducible and do not depend on num_threads.
+void pmc_run(coh_system* sys, trace_reader* readers, unsigned int num_threads,
+             unsigned int epoch, int exact);
+
+#endif
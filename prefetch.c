@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "prefetch.h"
+
+// Next-N-line: every trigger asks for the degree blocks starting distance
+// blocks past the one accessed
+
+static size_t next_line_state_size(void)
+{
+    return 0;
+}
+
+static void next_line_init(void* state)
+{
+}
+
+static unsigned int next_line_observe(void* state, uintptr_t block,
+                                      int trigger, unsigned int degree,
+                                      unsigned int distance, uintptr_t* out)
+{
+    if (!trigger)
+        return 0;
+    unsigned int i;
+    for (i = 0; i < degree; i++)
+        out[i] = block + distance + i;
+    return degree;
+}
+
+// Stride without program counters: the delta between successive blocks
+// accessed. Once the same delta is seen twice in a row, every new block
+// asks for the degree blocks distance strides ahead of it.
+
+typedef struct stride_state
+{
+    uintptr_t last;         // block of the last access, UINTPTR_MAX at first
+    uintptr_t delta;        // last delta, modulo the address space
+    int confirmed;
+} stride_state;
+
+static size_t stride_state_size(void)
+{
+    return sizeof(stride_state);
+}
+
+static void stride_init(void* state)
+{
+    stride_state* s = state;
+    s->last = UINTPTR_MAX;
+    s->delta = 0;
+    s->confirmed = 0;
+}
+
+static unsigned int stride_observe(void* state, uintptr_t block, int trigger,
+                                   unsigned int degree, unsigned int distance,
+                                   uintptr_t* out)
+{
+    stride_state* s = state;
+    if (block == s->last)
+        return 0;
+    if (s->last != UINTPTR_MAX)
+    {
+        uintptr_t delta = block - s->last;
+        s->confirmed = delta == s->delta;
+        s->delta = delta;
+    }
+    s->last = block;
+    if (!s->confirmed)
+        return 0;
+
+    unsigned int i;
+    for (i = 0; i < degree; i++)
+        out[i] = block + s->delta * (distance + i);
+    return degree;
+}
+
+// Streams: up to PF_STREAMS runs of triggers in one direction. A trigger
+// within PF_STREAM_WINDOW blocks of the end of a stream extends it, the
+// second one fixing its direction, and a stream with a direction asks for
+// the degree blocks distance blocks ahead of each trigger. Other triggers
+// start a new stream in place of the least recently extended one.
+
+typedef struct stream
+{
+    uintptr_t last;         // last block of the stream
+    int dir;                // 1 or -1, 0 until the second trigger
+    unsigned int stamp;     // clock of the last trigger, 0 if unused
+} stream;
+
+typedef struct stream_state
+{
+    stream streams[PF_STREAMS];
+    unsigned int clock;
+} stream_state;
+
+static size_t stream_state_size(void)
+{
+    return sizeof(stream_state);
+}
+
+static void stream_init(void* state)
+{
+    memset(state, 0, sizeof(stream_state));
+}
+
+static unsigned int stream_observe(void* state, uintptr_t block, int trigger,
+                                   unsigned int degree, unsigned int distance,
+                                   uintptr_t* out)
+{
+    stream_state* s = state;
+    if (!trigger)
+        return 0;
+    ++s->clock;
+
+    stream* victim = &s->streams[0];
+    unsigned int i;
+    for (i = 0; i < PF_STREAMS; i++)
+    {
+        stream* st = &s->streams[i];
+        if (st->stamp < victim->stamp)
+            victim = st;
+        if (st->stamp == 0)
+            continue;
+        uintptr_t ahead = block - st->last;
+        uintptr_t behind = st->last - block;
+        int dir;
+        if (ahead != 0 && ahead <= PF_STREAM_WINDOW && st->dir >= 0)
+            dir = 1;
+        else if (behind != 0 && behind <= PF_STREAM_WINDOW && st->dir <= 0)
+            dir = -1;
+        else
+            continue;
+
+        st->dir = dir;
+        st->last = block;
+        st->stamp = s->clock;
+        for (i = 0; i < degree; i++)
+            out[i] = block + (uintptr_t) dir * (distance + i);
+        return degree;
+    }
+
+    victim->last = block;
+    victim->dir = 0;
+    victim->stamp = s->clock;
+    return 0;
+}
+
+const prefetcher pf_next_line = {
+    "next", next_line_state_size, next_line_init, next_line_observe
+};
+
+const prefetcher pf_stride = {
+    "stride", stride_state_size, stride_init, stride_observe
+};
+
+const prefetcher pf_stream = {
+    "stream", stream_state_size, stream_init, stream_observe
+};
+
+static const prefetcher* const prefetchers[] = {
+    &pf_next_line, &pf_stride, &pf_stream
+};
+
+const prefetcher* pf_find(const char* name)
+{
+    size_t i;
+    for (i = 0; i < sizeof(prefetchers) / sizeof(prefetchers[0]); i++)
+    {
+        if (strcmp(prefetchers[i]->name, name) == 0)
+            return prefetchers[i];
+    }
+    return 0;
+}
+
+const char* pf_names()
+{
+    return "next, stride, stream";
+}
@@ -0,0 +1,45 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Most blocks a prefetcher may ask for at once
+#define PF_MAX_DEGREE 64
+
+// Streams the stream prefetcher tracks, and how many blocks past the end of
+// a stream a miss may land and still extend it
+#define PF_STREAMS 8
+#define PF_STREAM_WINDOW 16
+
+// A prefetcher watches the demand accesses of a cache, by block number, and
+// names blocks to fetch ahead of them. It keeps state_size() bytes of state
+// and knows nothing of the cache, which filters and fills what it asks for.
+typedef struct prefetcher
+{
+    const char* name;
+
+    size_t (*state_size)(void);
+
+    void (*init)(void* state);
+
+    // Called on every demand access of block. trigger is 1 on a miss or the
+    // first use of a prefetched block, 0 on other hits. Writes up to degree
+    // block numbers to out, distance or more blocks ahead, and returns how
+    // many it wrote.
+    unsigned int (*observe)(void* state, uintptr_t block, int trigger,
+                            unsigned int degree, unsigned int distance,
+                            uintptr_t* out);
+} prefetcher;
+
+extern const prefetcher pf_next_line;
+extern const prefetcher pf_stride;
+extern const prefetcher pf_stream;
+
+// Returns the prefetcher called name, or 0 if there is none
+const prefetcher* pf_find(const char* name);
+
+// List of prefetcher names, for usage messages
+const char* pf_names();
+
+#endif
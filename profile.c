@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "profile.h"
+#include "replacement.h"
+
+#define PROF_NONE UINT_MAX
+
+// Fibonacci hashing, as in the tag hash table of the caches
+static inline uintptr_t prof_hash(uintptr_t key, uintptr_t mask)
+{
+    return (key * (uintptr_t) 0x9E3779B97F4A7C15ull >> 17) & mask;
+}
+
+cache_profile* prof_init(unsigned int num_sets, unsigned int num_ways)
+{
+    cache_profile* result = malloc(sizeof(cache_profile));
+    result->num_sets = num_sets;
+    result->sets = calloc(num_sets, sizeof(prof_set));
+
+    unsigned int num_lines = num_sets * num_ways;
+    result->num_lines = num_lines;
+    result->shadow_used = 0;
+    result->shadow_blocks = malloc(num_lines * sizeof(uintptr_t));
+    result->shadow_lru = malloc(repl_lru.meta_size(num_lines));
+    repl_lru.init(result->shadow_lru, num_lines);
+    uintptr_t num_buckets = 1;
+    while (num_buckets < 2 * (uintptr_t) num_lines)
+        num_buckets <<= 1;
+    result->shadow_heads = malloc(num_buckets * sizeof(unsigned int));
+    result->shadow_next = malloc(num_lines * sizeof(unsigned int));
+    result->shadow_mask = num_buckets - 1;
+    uintptr_t i;
+    for (i = 0; i < num_buckets; i++)
+        result->shadow_heads[i] = PROF_NONE;
+
+    result->seen_mask = 63;
+    result->seen_used = 0;
+    result->seen_pages = calloc(result->seen_mask + 1, sizeof(uintptr_t));
+    result->seen_bits = malloc((result->seen_mask + 1) * sizeof(uint64_t*));
+
+    result->num_top = 0;
+    for (i = 0; i < 2 * PROF_TOP_BLOCKS; i++)
+        result->top_heads[i] = PROF_NONE;
+    return result;
+}
+
+// Returns the bits of page, allocating them cleared on first use
+static uint64_t* seen_page(cache_profile* prof, uintptr_t page)
+{
+    uintptr_t slot = prof_hash(page, prof->seen_mask);
+    while (prof->seen_pages[slot] != 0)
+    {
+        if (prof->seen_pages[slot] == page + 1)
+            return prof->seen_bits[slot];
+        slot = (slot + 1) & prof->seen_mask;
+    }
+
+    // keep the table at most half full
+    if (2 * (prof->seen_used + 1) > prof->seen_mask + 1)
+    {
+        uintptr_t old_mask = prof->seen_mask;
+        uintptr_t* old_pages = prof->seen_pages;
+        uint64_t** old_bits = prof->seen_bits;
+        prof->seen_mask = 2 * old_mask + 1;
+        prof->seen_pages = calloc(prof->seen_mask + 1, sizeof(uintptr_t));
+        prof->seen_bits = malloc((prof->seen_mask + 1) * sizeof(uint64_t*));
+        uintptr_t i;
+        for (i = 0; i <= old_mask; i++)
+        {
+            if (old_pages[i] == 0)
+                continue;
+            uintptr_t s = prof_hash(old_pages[i] - 1, prof->seen_mask);
+            while (prof->seen_pages[s] != 0)
+                s = (s + 1) & prof->seen_mask;
+            prof->seen_pages[s] = old_pages[i];
+            prof->seen_bits[s] = old_bits[i];
+        }
+        free(old_pages);
+        free(old_bits);
+        slot = prof_hash(page, prof->seen_mask);
+        while (prof->seen_pages[slot] != 0)
+            slot = (slot + 1) & prof->seen_mask;
+    }
+    ++prof->seen_used;
+    prof->seen_pages[slot] = page + 1;
+    prof->seen_bits[slot] = calloc(PROF_PAGE_BLOCKS / 64, sizeof(uint64_t));
+    return prof->seen_bits[slot];
+}
+
+// Marks block seen; returns 1 if it was already
+static int seen(cache_profile* prof, uintptr_t block)
+{
+    uint64_t* bits = seen_page(prof, block / PROF_PAGE_BLOCKS);
+    uintptr_t bit = block % PROF_PAGE_BLOCKS;
+    uint64_t mask = (uint64_t) 1 << (bit % 64);
+    int result = (bits[bit / 64] & mask) != 0;
+    bits[bit / 64] |= mask;
+    return result;
+}
+
+// Accesses block in the shadow cache; returns 1 on a hit
+static int shadow_access(cache_profile* prof, uintptr_t block)
+{
+    unsigned int* link = &prof->shadow_heads[prof_hash(block,
+                                                       prof->shadow_mask)];
+    unsigned int line = *link;
+    while (line != PROF_NONE && prof->shadow_blocks[line] != block)
+        line = prof->shadow_next[line];
+    if (line != PROF_NONE)
+    {
+        repl_lru.touch(prof->shadow_lru, prof->num_lines, line);
+        return 1;
+    }
+
+    if (prof->shadow_used < prof->num_lines)
+        line = prof->shadow_used++;
+    else
+    {
+        line = repl_lru.victim(prof->shadow_lru, prof->num_lines, 0);
+        unsigned int* old = &prof->shadow_heads[
+            prof_hash(prof->shadow_blocks[line], prof->shadow_mask)];
+        while (*old != line)
+            old = &prof->shadow_next[*old];
+        *old = prof->shadow_next[line];
+    }
+    prof->shadow_blocks[line] = block;
+    prof->shadow_next[line] = *link;
+    *link = line;
+    repl_lru.insert(prof->shadow_lru, prof->num_lines, line, 0);
+    return 0;
+}
+
+// Moves the counter at heap position i down to its place by count
+static void top_sift(cache_profile* prof, unsigned int i)
+{
+    unsigned int counter = prof->top_heap[i];
+    for (;;)
+    {
+        unsigned int child = 2 * i + 1;
+        if (child >= prof->num_top)
+            break;
+        if (child + 1 < prof->num_top
+            && prof->top[prof->top_heap[child + 1]].count
+               < prof->top[prof->top_heap[child]].count)
+            ++child;
+        if (prof->top[prof->top_heap[child]].count
+            >= prof->top[counter].count)
+            break;
+        prof->top_heap[i] = prof->top_heap[child];
+        prof->top_pos[prof->top_heap[i]] = i;
+        i = child;
+    }
+    prof->top_heap[i] = counter;
+    prof->top_pos[counter] = i;
+}
+
+// Counts an access to block in the sketch
+static void top_access(cache_profile* prof, uintptr_t block)
+{
+    unsigned int* heads = prof->top_heads;
+    uintptr_t bucket = prof_hash(block, 2 * PROF_TOP_BLOCKS - 1);
+    unsigned int counter = heads[bucket];
+    while (counter != PROF_NONE && prof->top[counter].block != block)
+        counter = prof->top_next[counter];
+    if (counter != PROF_NONE)
+    {
+        ++prof->top[counter].count;
+        top_sift(prof, prof->top_pos[counter]);
+        return;
+    }
+
+    unsigned int error = 0;
+    if (prof->num_top < PROF_TOP_BLOCKS)
+    {
+        // a new counter starts at the bottom of the heap, which a count
+        // of 1 cannot sift past
+        counter = prof->num_top++;
+        prof->top_heap[counter] = counter;
+        prof->top_pos[counter] = counter;
+        unsigned int i = counter;
+        while (i > 0 && prof->top[prof->top_heap[(i - 1) / 2]].count > 1)
+        {
+            prof->top_heap[i] = prof->top_heap[(i - 1) / 2];
+            prof->top_pos[prof->top_heap[i]] = i;
+            i = (i - 1) / 2;
+        }
+        prof->top_heap[i] = counter;
+        prof->top_pos[counter] = i;
+    }
+    else
+    {
+        // take over the coldest counter
+        counter = prof->top_heap[0];
+        error = prof->top[counter].count;
+        unsigned int* old = &heads[prof_hash(prof->top[counter].block,
+                                             2 * PROF_TOP_BLOCKS - 1)];
+        while (*old != counter)
+            old = &prof->top_next[*old];
+        *old = prof->top_next[counter];
+    }
+    prof->top[counter].block = block;
+    prof->top[counter].count = error + 1;
+    prof->top[counter].error = error;
+    prof->top_next[counter] = heads[bucket];
+    heads[bucket] = counter;
+    top_sift(prof, prof->top_pos[counter]);
+}
+
+void prof_access(cache_profile* prof, unsigned int set, uintptr_t block,
+                 int miss)
+{
+    prof_set* s = &prof->sets[set];
+    ++s->accesses;
+    int was_seen = seen(prof, block);
+    int shadow_hit = shadow_access(prof, block);
+    if (miss)
+    {
+        if (!was_seen)
+            ++s->misses[PROF_COMPULSORY];
+        else if (!shadow_hit)
+            ++s->misses[PROF_CAPACITY];
+        else
+            ++s->misses[PROF_CONFLICT];
+    }
+    top_access(prof, block);
+}
+
+void prof_misses(const cache_profile* prof, unsigned int* misses)
+{
+    misses[PROF_COMPULSORY] = misses[PROF_CAPACITY] = 0;
+    misses[PROF_CONFLICT] = 0;
+    unsigned int i;
+    for (i = 0; i < prof->num_sets; i++)
+    {
+        misses[PROF_COMPULSORY] += prof->sets[i].misses[PROF_COMPULSORY];
+        misses[PROF_CAPACITY] += prof->sets[i].misses[PROF_CAPACITY];
+        misses[PROF_CONFLICT] += prof->sets[i].misses[PROF_CONFLICT];
+    }
+}
+
+// All misses of s
+static unsigned int set_misses(const prof_set* s)
+{
+    return s->misses[PROF_COMPULSORY] + s->misses[PROF_CAPACITY]
+           + s->misses[PROF_CONFLICT];
+}
+
+unsigned int prof_hottest_set(const cache_profile* prof)
+{
+    unsigned int result = 0;
+    unsigned int i;
+    for (i = 1; i < prof->num_sets; i++)
+    {
+        if (set_misses(&prof->sets[i]) > set_misses(&prof->sets[result]))
+            result = i;
+    }
+    return result;
+}
+
+void prof_write_sets(const cache_profile* prof, FILE* file)
+{
+    fprintf(file, "set,accesses,misses,compulsory,capacity,conflict,"
+                  "evictions\n");
+    unsigned int i;
+    for (i = 0; i < prof->num_sets; i++)
+    {
+        const prof_set* s = &prof->sets[i];
+        fprintf(file, "%u,%u,%u,%u,%u,%u,%u\n", i, s->accesses,
+                set_misses(s), s->misses[PROF_COMPULSORY],
+                s->misses[PROF_CAPACITY], s->misses[PROF_CONFLICT],
+                s->evictions);
+    }
+}
+
+// Orders counters hottest first, then by block
+static int compare_counters(const void* a, const void* b)
+{
+    const prof_counter* x = a;
+    const prof_counter* y = b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return (x->block > y->block) - (x->block < y->block);
+}
+
+void prof_write_blocks(const cache_profile* prof, FILE* file,
+                       size_t block_size)
+{
+    prof_counter sorted[PROF_TOP_BLOCKS];
+    memcpy(sorted, prof->top, prof->num_top * sizeof(prof_counter));
+    qsort(sorted, prof->num_top, sizeof(prof_counter), compare_counters);
+
+    fprintf(file, "rank,address,accesses,error\n");
+    unsigned int i;
+    for (i = 0; i < prof->num_top; i++)
+    {
+        fprintf(file, "%u,0x%llx,%u,%u\n", i + 1,
+                (unsigned long long) sorted[i].block * block_size,
+                sorted[i].count, sorted[i].error);
+    }
+}
+
+void prof_free(cache_profile* prof)
+{
+    uintptr_t i;
+    for (i = 0; i <= prof->seen_mask; i++)
+    {
+        if (prof->seen_pages[i] != 0)
+            free(prof->seen_bits[i]);
+    }
+    free(prof->seen_pages);
+    free(prof->seen_bits);
+    free(prof->sets);
+    free(prof->shadow_blocks);
+    free(prof->shadow_lru);
+    free(prof->shadow_heads);
+    free(prof->shadow_next);
+    free(prof);
+}
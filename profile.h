@@ -0,0 +1,106 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Blocks the hottest-block sketch counts at once
+#define PROF_TOP_BLOCKS 64
+
+// Blocks per page of the seen-block bitmap
+#define PROF_PAGE_BLOCKS 4096
+
+// Classes of a miss: the first access to its block, a miss a fully
+// associative LRU cache of the same size would have too, or one only the
+// mapping to sets caused
+#define PROF_COMPULSORY 0
+#define PROF_CAPACITY 1
+#define PROF_CONFLICT 2
+
+typedef struct prof_set
+{
+    unsigned int accesses;
+    unsigned int misses[3];     // by class
+    unsigned int evictions;
+} prof_set;
+
+// Space-saving counter: block was accessed count times since it was
+// tracked, plus at most error times before
+typedef struct prof_counter
+{
+    uintptr_t block;
+    unsigned int count;
+    unsigned int error;
+} prof_counter;
+
+// Profile of the demand accesses of one cache: counters per set, 3C classes
+// of the misses, and the hottest blocks. The 3C classes come from a shadow
+// fully associative LRU cache with as many lines as the cache, and a bitmap
+// of the blocks seen so far. The bitmap is kept in pages found by hash, so
+// it follows the blocks accessed rather than the size of memory. The
+// hottest blocks are estimated by a space-saving sketch of
+// PROF_TOP_BLOCKS counters: a block that is not counted takes the counter
+// of the coldest one, and inherits its count as error.
+typedef struct cache_profile
+{
+    unsigned int num_sets;
+    prof_set* sets;
+
+    // Shadow cache: block of each line, LRU order, and a hash table from
+    // block to line chained through shadow_next
+    unsigned int num_lines;
+    unsigned int shadow_used;
+    uintptr_t* shadow_blocks;
+    void* shadow_lru;
+    unsigned int* shadow_heads;
+    unsigned int* shadow_next;
+    uintptr_t shadow_mask;
+
+    // Seen-block bitmap: open addressing table of page number + 1 (0 for
+    // empty) and the bits of each page
+    uintptr_t* seen_pages;
+    uint64_t** seen_bits;
+    uintptr_t seen_mask;
+    uintptr_t seen_used;
+
+    // Sketch: counters, a min-heap of their indexes by count with the
+    // position of each, and a hash table from block to counter
+    prof_counter top[PROF_TOP_BLOCKS];
+    unsigned int num_top;
+    unsigned int top_heap[PROF_TOP_BLOCKS];
+    unsigned int top_pos[PROF_TOP_BLOCKS];
+    unsigned int top_heads[2 * PROF_TOP_BLOCKS];
+    unsigned int top_next[PROF_TOP_BLOCKS];
+} cache_profile;
+
+cache_profile* prof_init(unsigned int num_sets, unsigned int num_ways);
+
+// Records a demand access to block number block, which maps to set. miss is
+// 1 if the cache missed on it.
+void prof_access(cache_profile* prof, unsigned int set, uintptr_t block,
+                 int miss);
+
+// Records an eviction from set
+static inline void prof_evict(cache_profile* prof, unsigned int set)
+{
+    ++prof->sets[set].evictions;
+}
+
+// Adds up the misses of every set by class
+void prof_misses(const cache_profile* prof, unsigned int* misses);
+
+// Returns the set with the most misses
+unsigned int prof_hottest_set(const cache_profile* prof);
+
+// Writes a CSV line per set: set, accesses, misses by class, evictions
+void prof_write_sets(const cache_profile* prof, FILE* file);
+
+// Writes a CSV line per counted block, hottest first: rank, address of the
+// block, accesses counted and their error bound
+void prof_write_blocks(const cache_profile* prof, FILE* file,
+                       size_t block_size);
+
+void prof_free(cache_profile* prof);
+
+#endif
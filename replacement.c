@@ -0,0 +1,280 @@
+#include <string.h>
+
+#include "replacement.h"
+
+// LRU: a doubly-linked recency list of way numbers.
+// meta = [mru, lru, prev[num_ways], next[num_ways]], where prev points to the
+// next less recently used way and next to the next more recently used one.
+
+static size_t lru_meta_size(unsigned int num_ways)
+{
+    return (2 + 2 * (size_t) num_ways) * sizeof(uint32_t);
+}
+
+static void lru_init(void* meta, unsigned int num_ways)
+{
+    uint32_t* m = meta;
+    uint32_t* prev = m + 2;
+    uint32_t* next = prev + num_ways;
+    unsigned int w;
+    for (w = 0; w < num_ways; w++)
+    {
+        prev[w] = w - 1;
+        next[w] = w + 1;
+    }
+    m[0] = num_ways - 1;
+    m[1] = 0;
+}
+
+static void lru_touch(void* meta, unsigned int num_ways, unsigned int way)
+{
+    uint32_t* m = meta;
+    uint32_t* prev = m + 2;
+    uint32_t* next = prev + num_ways;
+    if (m[0] == way)
+        return;
+
+    // unlink; way is not the MRU so it has a more recent neighbour
+    if (m[1] == way)
+        m[1] = next[way];
+    else
+        next[prev[way]] = next[way];
+    prev[next[way]] = prev[way];
+
+    // relink at the MRU end
+    next[m[0]] = way;
+    prev[way] = m[0];
+    m[0] = way;
+}
+
+static unsigned int lru_victim(void* meta, unsigned int num_ways, uint64_t* rng)
+{
+    return ((uint32_t*) meta)[1];
+}
+
+static void lru_insert(void* meta, unsigned int num_ways, unsigned int way,
+                       uint64_t* rng)
+{
+    lru_touch(meta, num_ways, way);
+}
+
+// Tree-PLRU: one bit per internal node of a binary tree over the ways, heap
+// ordered from node 1. A set bit means the next victim is in the right
+// subtree. Ways are the leaves num_ways .. 2 * num_ways - 1.
+
+static size_t plru_meta_size(unsigned int num_ways)
+{
+    return ((num_ways + 63) / 64) * sizeof(uint64_t);
+}
+
+static void plru_init(void* meta, unsigned int num_ways)
+{
+    memset(meta, 0, plru_meta_size(num_ways));
+}
+
+static void plru_touch(void* meta, unsigned int num_ways, unsigned int way)
+{
+    uint64_t* bits = meta;
+    unsigned int node = way + num_ways;
+    while (node > 1)
+    {
+        unsigned int parent = node >> 1;
+        uint64_t mask = (uint64_t) 1 << (parent & 63);
+        // point the parent away from the subtree we came from
+        if (node & 1)
+            bits[parent >> 6] &= ~mask;
+        else
+            bits[parent >> 6] |= mask;
+        node = parent;
+    }
+}
+
+static unsigned int plru_victim(void* meta, unsigned int num_ways, uint64_t* rng)
+{
+    uint64_t* bits = meta;
+    unsigned int node = 1;
+    while (node < num_ways)
+        node = 2 * node + ((bits[node >> 6] >> (node & 63)) & 1);
+    return node - num_ways;
+}
+
+static void plru_insert(void* meta, unsigned int num_ways, unsigned int way,
+                        uint64_t* rng)
+{
+    plru_touch(meta, num_ways, way);
+}
+
+// RRIP: a 2-bit re-reference prediction value per way, 32 ways per word.
+// Hits predict near re-reference (0); the victim is the first way predicted
+// distant (3), ageing the whole set until one is. SRRIP inserts at 2, BRRIP
+// inserts at 3 and only occasionally at 2.
+
+#define RRIP_MAX 3
+#define BRRIP_LONG_ONE_IN 32
+
+static inline unsigned int rrpv_get(uint64_t* m, unsigned int way)
+{
+    return (m[way >> 5] >> ((way & 31) * 2)) & 3;
+}
+
+static inline void rrpv_set(uint64_t* m, unsigned int way, unsigned int val)
+{
+    unsigned int shift = (way & 31) * 2;
+    m[way >> 5] = (m[way >> 5] & ~((uint64_t) 3 << shift))
+                  | ((uint64_t) val << shift);
+}
+
+static size_t rrip_meta_size(unsigned int num_ways)
+{
+    return ((num_ways + 31) / 32) * sizeof(uint64_t);
+}
+
+static void rrip_init(void* meta, unsigned int num_ways)
+{
+    // every way starts predicted distant
+    memset(meta, 0xff, rrip_meta_size(num_ways));
+}
+
+static void rrip_touch(void* meta, unsigned int num_ways, unsigned int way)
+{
+    rrpv_set(meta, way, 0);
+}
+
+static unsigned int rrip_victim(void* meta, unsigned int num_ways, uint64_t* rng)
+{
+    uint64_t* m = meta;
+    unsigned int max = 0;
+    unsigned int result = 0;
+    unsigned int w;
+    for (w = 0; w < num_ways; w++)
+    {
+        unsigned int rrpv = rrpv_get(m, w);
+        if (rrpv > max)
+        {
+            max = rrpv;
+            result = w;
+            if (max == RRIP_MAX)
+                return result;
+        }
+    }
+
+    // age the set until the oldest way reaches RRIP_MAX
+    for (w = 0; w < num_ways; w++)
+        rrpv_set(m, w, rrpv_get(m, w) + RRIP_MAX - max);
+    return result;
+}
+
+static void srrip_insert(void* meta, unsigned int num_ways, unsigned int way,
+                         uint64_t* rng)
+{
+    rrpv_set(meta, way, RRIP_MAX - 1);
+}
+
+static void brrip_insert(void* meta, unsigned int num_ways, unsigned int way,
+                         uint64_t* rng)
+{
+    if (repl_rand(rng) % BRRIP_LONG_ONE_IN == 0)
+        rrpv_set(meta, way, RRIP_MAX - 1);
+    else
+        rrpv_set(meta, way, RRIP_MAX);
+}
+
+// FIFO: the way that will be replaced next. Fills of an empty set happen in
+// way order, so the pointer only has to follow them.
+
+static size_t fifo_meta_size(unsigned int num_ways)
+{
+    return sizeof(uint32_t);
+}
+
+static void fifo_init(void* meta, unsigned int num_ways)
+{
+    *(uint32_t*) meta = 0;
+}
+
+static void fifo_touch(void* meta, unsigned int num_ways, unsigned int way)
+{
+}
+
+static unsigned int fifo_victim(void* meta, unsigned int num_ways, uint64_t* rng)
+{
+    return *(uint32_t*) meta;
+}
+
+static void fifo_insert(void* meta, unsigned int num_ways, unsigned int way,
+                        uint64_t* rng)
+{
+    uint32_t* next = meta;
+    if (*next == way)
+        *next = (way + 1) % num_ways;
+}
+
+// Random: no state beyond the cache's random source
+
+static size_t random_meta_size(unsigned int num_ways)
+{
+    return 0;
+}
+
+static void random_init(void* meta, unsigned int num_ways)
+{
+}
+
+static void random_touch(void* meta, unsigned int num_ways, unsigned int way)
+{
+}
+
+static unsigned int random_victim(void* meta, unsigned int num_ways, uint64_t* rng)
+{
+    return repl_rand(rng) % num_ways;
+}
+
+static void random_insert(void* meta, unsigned int num_ways, unsigned int way,
+                          uint64_t* rng)
+{
+}
+
+const replacement_policy repl_lru = {
+    "lru", 0, lru_meta_size, lru_init, lru_touch, lru_victim, lru_insert
+};
+
+const replacement_policy repl_plru = {
+    "plru", 1, plru_meta_size, plru_init, plru_touch, plru_victim, plru_insert
+};
+
+const replacement_policy repl_srrip = {
+    "srrip", 0, rrip_meta_size, rrip_init, rrip_touch, rrip_victim, srrip_insert
+};
+
+const replacement_policy repl_brrip = {
+    "brrip", 0, rrip_meta_size, rrip_init, rrip_touch, rrip_victim, brrip_insert
+};
+
+const replacement_policy repl_fifo = {
+    "fifo", 0, fifo_meta_size, fifo_init, fifo_touch, fifo_victim, fifo_insert
+};
+
+const replacement_policy repl_random = {
+    "random", 0, random_meta_size, random_init, random_touch, random_victim,
+    random_insert
+};
+
+static const replacement_policy* const policies[] = {
+    &repl_lru, &repl_plru, &repl_srrip, &repl_brrip, &repl_fifo, &repl_random
+};
+
+const replacement_policy* repl_find(const char* name)
+{
+    size_t i;
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    {
+        if (strcmp(policies[i]->name, name) == 0)
+            return policies[i];
+    }
+    return 0;
+}
+
+const char* repl_names()
+{
+    return "lru, plru, srrip, brrip, fifo, random";
+}
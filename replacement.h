@@ -0,0 +1,55 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A replacement policy keeps a small block of metadata per set and is told
+// about every hit (touch) and fill (insert). The cache fills invalid ways
+// itself and only asks the policy for a victim once the set is full.
+typedef struct replacement_policy
+{
+    const char* name;
+    int pow2_ways;          // 1 if the policy needs a power-of-two way count
+
+    // Bytes of metadata needed by one set of num_ways ways
+    size_t (*meta_size)(unsigned int num_ways);
+
+    void (*init)(void* meta, unsigned int num_ways);
+
+    // Called when way hits
+    void (*touch)(void* meta, unsigned int num_ways, unsigned int way);
+
+    // Returns the way to evict from a full set
+    unsigned int (*victim)(void* meta, unsigned int num_ways, uint64_t* rng);
+
+    // Called after a block has been loaded into way
+    void (*insert)(void* meta, unsigned int num_ways, unsigned int way,
+                   uint64_t* rng);
+} replacement_policy;
+
+extern const replacement_policy repl_lru;
+extern const replacement_policy repl_plru;
+extern const replacement_policy repl_srrip;
+extern const replacement_policy repl_brrip;
+extern const replacement_policy repl_fifo;
+extern const replacement_policy repl_random;
+
+// Returns the policy called name, or 0 if there is none
+const replacement_policy* repl_find(const char* name);
+
+// Comma separated list of policy names, for usage messages
+const char* repl_names();
+
+// xorshift64, the random source for the random policy and BRRIP
+static inline uint64_t repl_rand(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+#endif
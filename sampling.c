@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sampling.h"
+
+// z for a two-sided 95% confidence interval
+#define SMP_Z95 1.96
+
+static uint32_t set_hash(unsigned int set)
+{
+    uint32_t h = set * 0x9E3779B1u;
+    return h ^ (h >> 15);
+}
+
+static int by_hash(const void* a, const void* b)
+{
+    uint32_t ha = set_hash(*(const unsigned int*) a);
+    uint32_t hb = set_hash(*(const unsigned int*) b);
+    return (ha > hb) - (ha < hb);
+}
+
+sampler* smp_init(cache* c, main_memory* mm, unsigned int set_ratio,
+                  unsigned long long period, unsigned long long window,
+                  unsigned long long warmup)
+{
+    sampler* result = malloc(sizeof(sampler));
+    result->c = c;
+    result->mm = mm;
+    result->set_ratio = set_ratio;
+    result->period = period;
+    result->window = window;
+    result->warmup = warmup;
+    result->accesses = 0;
+    result->total = cs_init();
+    result->mm_writes = 0;
+    result->mm_reads = 0;
+
+    // Take the sets with the lowest hashes, so exactly 1 in set_ratio sets
+    // (rounded up) is simulated and strided sets are not picked together
+    unsigned int num_sets = c->num_sets;
+    result->num_sampled = (num_sets + set_ratio - 1) / set_ratio;
+    result->sampled = calloc(num_sets, 1);
+    unsigned int* order = malloc(num_sets * sizeof(unsigned int));
+    unsigned int i;
+    for (i = 0; i < num_sets; i++)
+        order[i] = i;
+    qsort(order, num_sets, sizeof(unsigned int), by_hash);
+    for (i = 0; i < result->num_sampled; i++)
+        result->sampled[order[i]] = 1;
+    free(order);
+
+    // Clusters are sets, or windows when time sampling, which grow
+    result->cap = period ? 64 : num_sets;
+    result->num_clusters = period ? 0 : num_sets;
+    result->clusters = calloc(result->cap, sizeof(smp_cluster));
+    return result;
+}
+
+void smp_access(sampler* smp, const trace_record* r)
+{
+    cache* c = smp->c;
+    void* addr = (void*) r->addr;
+    unsigned long long t = smp->accesses++;
+    if (r->op == TRACE_WRITE)
+        ++smp->total.w_queries;
+    else
+        ++smp->total.r_queries;
+
+    unsigned int set = addr_set_index(&c->layout, addr);
+    if (!smp->sampled[set])
+        return;
+
+    size_t cluster = set;
+    int measure = 1;
+    if (smp->period)
+    {
+        unsigned long long pos = t % smp->period;
+        if (pos >= smp->warmup + smp->window)
+            return;
+        measure = pos >= smp->warmup;
+        cluster = t / smp->period;
+        if (measure && cluster >= smp->num_clusters)
+        {
+            if (cluster >= smp->cap)
+            {
+                size_t old_cap = smp->cap;
+                while (cluster >= smp->cap)
+                    smp->cap *= 2;
+                smp->clusters = realloc(smp->clusters,
+                                        smp->cap * sizeof(smp_cluster));
+                memset(smp->clusters + old_cap, 0,
+                       (smp->cap - old_cap) * sizeof(smp_cluster));
+            }
+            smp->num_clusters = cluster + 1;
+        }
+    }
+
+    cache_stats before = c->cs;
+    unsigned int mm_writes = smp->mm->w_queries;
+    unsigned int mm_reads = smp->mm->r_queries;
+    if (r->op == TRACE_WRITE)
+        cache_store_word(c, addr, r->val);
+    else
+        cache_load_word(c, addr);
+    if (!measure)
+        return;
+
+    smp_cluster* cl = &smp->clusters[cluster];
+    if (r->op == TRACE_WRITE)
+    {
+        ++cl->w_queries;
+        cl->w_hits += c->cs.w_misses == before.w_misses;
+    }
+    else
+    {
+        ++cl->r_queries;
+        cl->r_hits += c->cs.r_misses == before.r_misses;
+    }
+    smp->mm_writes += smp->mm->w_queries - mm_writes;
+    smp->mm_reads += smp->mm->r_queries - mm_reads;
+}
+
+// Ratio estimate of sum(hits) / sum(queries) over the sampling units, with
+// the usual linearized variance and a finite population correction for
+// units out of population
+static smp_rate ratio_estimate(const unsigned long long* hits,
+                               const unsigned long long* queries, size_t n,
+                               double population)
+{
+    smp_rate result;
+    double h = 0;
+    double q = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        h += hits[i];
+        q += queries[i];
+    }
+    result.rate = q > 0 ? h / q : NAN;
+    result.error = NAN;
+    if (q == 0)
+        return result;
+    if (n >= population)
+    {
+        result.error = 0;
+        return result;
+    }
+    if (n < 2)
+        return result;
+
+    double ss = 0;
+    for (i = 0; i < n; i++)
+    {
+        double d = hits[i] - result.rate * queries[i];
+        ss += d * d;
+    }
+    double mean_q = q / n;
+    double var = (1 - n / population) * ss / (n - 1) / n / (mean_q * mean_q);
+    result.error = SMP_Z95 * sqrt(var);
+    return result;
+}
+
+void smp_hit_rates(const sampler* smp, smp_rate* read, smp_rate* write,
+                   smp_rate* total)
+{
+    // gather the units: the measured windows out of every window-sized
+    // stretch of the trace, or the sampled sets out of all sets
+    size_t n = 0;
+    double population;
+    unsigned long long* r_h = malloc(6 * smp->num_clusters
+                                     * sizeof(unsigned long long));
+    unsigned long long* r_q = r_h + smp->num_clusters;
+    unsigned long long* w_h = r_q + smp->num_clusters;
+    unsigned long long* w_q = w_h + smp->num_clusters;
+    unsigned long long* t_h = w_q + smp->num_clusters;
+    unsigned long long* t_q = t_h + smp->num_clusters;
+    size_t i;
+    for (i = 0; i < smp->num_clusters; i++)
+    {
+        if (!smp->period && !smp->sampled[i])
+            continue;
+        const smp_cluster* cl = &smp->clusters[i];
+        r_h[n] = cl->r_hits;
+        r_q[n] = cl->r_queries;
+        w_h[n] = cl->w_hits;
+        w_q[n] = cl->w_queries;
+        t_h[n] = cl->r_hits + cl->w_hits;
+        t_q[n] = cl->r_queries + cl->w_queries;
+        ++n;
+    }
+    if (smp->period)
+        population = (double) smp->accesses / smp->window;
+    else
+        population = smp->c->num_sets;
+
+    *read = ratio_estimate(r_h, r_q, n, population);
+    *write = ratio_estimate(w_h, w_q, n, population);
+    *total = ratio_estimate(t_h, t_q, n, population);
+    free(r_h);
+}
+
+double smp_fraction(const sampler* smp)
+{
+    unsigned long long measured = 0;
+    size_t i;
+    for (i = 0; i < smp->num_clusters; i++)
+        measured += smp->clusters[i].r_queries + smp->clusters[i].w_queries;
+    return smp->accesses ? (double) measured / smp->accesses : 0;
+}
+
+void smp_free(sampler* smp)
+{
+    free(smp->sampled);
+    free(smp->clusters);
+    free(smp);
+}
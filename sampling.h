@@ -0,0 +1,72 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "cache.h"
+#include "trace.h"
+
+// Hits and queries of one sampling unit: a sampled set, or a measured time
+// window when time sampling is on
+typedef struct smp_cluster
+{
+    unsigned long long r_queries;
+    unsigned long long r_hits;
+    unsigned long long w_queries;
+    unsigned long long w_hits;
+} smp_cluster;
+
+// Sampled simulation of a cache. Set sampling simulates only the accesses
+// that map to a hashed subset of the sets; time sampling simulates a
+// warm-up stretch and then a measured window at the start of every period
+// and skips the rest. Both can be combined. Skipped accesses never reach
+// the cache, so sampled runs must be quiet: values read are not meaningful.
+typedef struct sampler
+{
+    cache* c;
+    main_memory* mm;        // memory below c
+
+    // Set sampling: sampled[set] is 1 for the simulated sets
+    unsigned int set_ratio;
+    unsigned char* sampled;
+    unsigned int num_sampled;
+
+    // Time sampling, off when period is 0
+    unsigned long long period;
+    unsigned long long window;
+    unsigned long long warmup;
+
+    unsigned long long accesses;    // all accesses seen
+    cache_stats total;              // queries of all accesses; no misses
+
+    // Measured accesses, per cluster, and their main memory traffic
+    smp_cluster* clusters;
+    size_t num_clusters;
+    size_t cap;
+    unsigned long long mm_writes;
+    unsigned long long mm_reads;
+} sampler;
+
+// An estimated rate with the half width of its 95% confidence interval
+typedef struct smp_rate
+{
+    double rate;
+    double error;
+} smp_rate;
+
+// set_ratio of 1 simulates every set; period of 0 turns time sampling off
+sampler* smp_init(cache* c, main_memory* mm, unsigned int set_ratio,
+                  unsigned long long period, unsigned long long window,
+                  unsigned long long warmup);
+
+// Feeds one access of the trace through the sampler
+void smp_access(sampler* smp, const trace_record* r);
+
+// Estimated read, write and total hit rates
+void smp_hit_rates(const sampler* smp, smp_rate* read, smp_rate* write,
+                   smp_rate* total);
+
+// Fraction of the accesses that were measured
+double smp_fraction(const sampler* smp);
+
+void smp_free(sampler* smp);
+
+#endif
@@ -3,31 +3,24 @@
 
 #include "main_memory.h"
 #include "cache_stats.h"
+#include "cache.h"
 
+// Default geometry, overridable at runtime through sac_config
 #define SET_ASSOCIATIVE_NUM_SETS 8
 #define SET_ASSOCIATIVE_NUM_SETS_LN 3
 #define SET_ASSOCIATIVE_NUM_WAYS 2
 #define SET_ASSOCIATIVE_NUM_WAYS_LN 1
 
-typedef struct Way{
-    memory_block* block;
-    int lru_priority;
-    int dirty;
-    int valid;
+typedef cache set_associative_cache;
 
-} Way;
+// Returns the default set associative geometry
+cache_config sac_config();
 
-typedef struct set{
-    Way ways[SET_ASSOCIATIVE_NUM_WAYS];
-} set;
-
-typedef struct set_associative_cache
-{
-    main_memory* mm;
-    cache_stats cs;
-	set sets[SET_ASSOCIATIVE_NUM_SETS];
-    // TODO: add anything you need
-} set_associative_cache;
+// Runs num_records accesses in order, with the same results as the single
+// word calls; see cache_access_batch
+void sac_access_batch(set_associative_cache* sac,
+                      const trace_record* records, size_t num_records,
+                      unsigned int* vals);
 
 // Do not edit below this line
 
@@ -39,4 +32,4 @@ unsigned int sac_load_word(set_associative_cache* sac, void* addr);
 
 void sac_free(set_associative_cache* sac);
 
-#endif
\ No newline at end of file
+#endif
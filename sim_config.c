@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "sim_config.h"
+#include "direct_mapped.h"
+#include "fully_associative.h"
+#include "set_associative.h"
+
+// Most values one key of a spec may list
+#define CFG_MAX_VALUES 64
+
+size_t cfg_parse_count(const char* flag, const char* str)
+{
+    char* end;
+    unsigned long long result = strtoull(str, &end, 0);
+    if (*str == '\0' || *end != '\0' || *str == '-' || result == 0)
+    {
+        fprintf(stderr, "Error: %s expects a positive integer, got '%s'.\n",
+                flag, str);
+        exit(2);
+    }
+    return (size_t) result;
+}
+
+const replacement_policy* cfg_parse_policy(const char* name)
+{
+    const replacement_policy* result = repl_find(name);
+    if (result == 0)
+    {
+        fprintf(stderr, "Error: Unknown policy %s. Policies: %s\n",
+                name, repl_names());
+        exit(2);
+    }
+    return result;
+}
+
+int cfg_parse_inclusion(const char* name)
+{
+    if (strcmp(name, "nine") == 0)
+        return CACHE_NINE;
+    if (strcmp(name, "inclusive") == 0)
+        return CACHE_INCLUSIVE;
+    if (strcmp(name, "exclusive") == 0)
+        return CACHE_EXCLUSIVE;
+    fprintf(stderr, "Error: Unknown inclusion policy %s. Policies: nine"
+                    " inclusive exclusive\n", name);
+    exit(2);
+}
+
+void cfg_set_write_policy(sim_config* cfg, const char* write,
+                          const char* alloc)
+{
+    if (cfg->mode == MODE_SC && (write || alloc))
+    {
+        fprintf(stderr, "Error: sc takes no write policy.\n");
+        exit(2);
+    }
+    if (write && strcmp(write, "back") == 0)
+        cfg->cfg.write_through = 0;
+    else if (write && strcmp(write, "through") == 0)
+        cfg->cfg.write_through = 1;
+    else if (write)
+    {
+        fprintf(stderr, "Error: Unknown write policy %s. Policies: back"
+                        " through\n", write);
+        exit(2);
+    }
+    if (alloc && strcmp(alloc, "yes") == 0)
+        cfg->cfg.write_allocate = 1;
+    else if (alloc && strcmp(alloc, "no") == 0)
+        cfg->cfg.write_allocate = 0;
+    else if (alloc)
+    {
+        fprintf(stderr, "Error: Write allocation must be yes or no, got"
+                        " %s.\n", alloc);
+        exit(2);
+    }
+}
+
+void cfg_set_prefetch(sim_config* cfg, const char* name, const char* degree,
+                      const char* distance)
+{
+    if (name == 0 && (degree || distance))
+    {
+        fprintf(stderr, "Error: A prefetch degree or distance needs a"
+                        " prefetcher.\n");
+        exit(2);
+    }
+    if (name == 0)
+        return;
+    if (cfg->mode == MODE_SC)
+    {
+        fprintf(stderr, "Error: sc takes no prefetcher.\n");
+        exit(2);
+    }
+    cfg->cfg.prefetch = pf_find(name);
+    if (cfg->cfg.prefetch == 0)
+    {
+        fprintf(stderr, "Error: Unknown prefetcher %s. Prefetchers: %s\n",
+                name, pf_names());
+        exit(2);
+    }
+    if (degree)
+        cfg->cfg.pf_degree = cfg_parse_count("degree", degree);
+    if (distance)
+        cfg->cfg.pf_distance = cfg_parse_count("distance", distance);
+    if (!cache_config_valid(&cfg->cfg))
+        exit(2);
+}
+
+void cfg_set_victim(sim_config* cfg, const char* victim,
+                    const char* misscache)
+{
+    if (victim == 0 && misscache == 0)
+        return;
+    if (victim && misscache)
+    {
+        fprintf(stderr, "Error: A cache has a victim cache or a miss cache,"
+                        " not both.\n");
+        exit(2);
+    }
+    if (cfg->mode == MODE_SC)
+    {
+        fprintf(stderr, "Error: sc takes no victim or miss cache.\n");
+        exit(2);
+    }
+    if (victim)
+    {
+        cfg->cfg.victim_kind = CACHE_VICTIM;
+        cfg->cfg.victim_entries = cfg_parse_count("victim", victim);
+    }
+    else
+    {
+        cfg->cfg.victim_kind = CACHE_MISS_CACHE;
+        cfg->cfg.victim_entries = cfg_parse_count("misscache", misscache);
+    }
+    if (!cache_config_valid(&cfg->cfg))
+        exit(2);
+}
+
+void cfg_make(const char* mode_name, size_t sets, size_t ways,
+              size_t block_size, size_t mem_size,
+              const replacement_policy* policy, sim_config* cfg)
+{
+    cfg->name = strdup(mode_name);
+    cfg->block_size = block_size;
+    cfg->latency = CFG_DEFAULT_LATENCY;
+    if (strcmp(mode_name, "sc") == 0)
+        cfg->mode = MODE_SC;
+    else if (strcmp(mode_name, "dmc") == 0)
+    {
+        cfg->mode = MODE_DMC;
+        cfg->cfg = dmc_config();
+    }
+    else if (strcmp(mode_name, "fac") == 0)
+    {
+        cfg->mode = MODE_FAC;
+        cfg->cfg = fac_config();
+    }
+    else if (strcmp(mode_name, "sac") == 0)
+    {
+        cfg->mode = MODE_SAC;
+        cfg->cfg = sac_config();
+    }
+    else
+    {
+        fprintf(stderr, "Error: Mode must be sc, dmc, fac, or sac.\n");
+        exit (2);
+    }
+
+    if ((cfg->mode == MODE_SC && (sets || ways || policy))
+        || (cfg->mode == MODE_DMC && ways > 1)
+        || (cfg->mode == MODE_FAC && sets > 1))
+    {
+        fprintf(stderr, "Error: %s does not take that geometry."
+                        " Use sac for a general sets x ways cache.\n",
+                mode_name);
+        exit(2);
+    }
+    if (sets > UINT_MAX || ways > UINT_MAX)
+    {
+        fprintf(stderr, "Error: Too many sets or ways.\n");
+        exit(2);
+    }
+    if (sets)
+        cfg->cfg.num_sets = sets;
+    if (ways)
+        cfg->cfg.num_ways = ways;
+    if (policy)
+        cfg->cfg.policy = policy;
+    // a word access must not run past the end of its block
+    if (block_size < sizeof(unsigned int)
+        || block_size % sizeof(unsigned int) != 0)
+    {
+        fprintf(stderr, "Error: Block size must be a positive multiple of"
+                        " %zu bytes.\n", sizeof(unsigned int));
+        exit(2);
+    }
+    if (mem_size > MM_MAX_SIZE)
+    {
+        fprintf(stderr, "Error: Memory size must be at most %zu bytes.\n",
+                MM_MAX_SIZE);
+        exit(2);
+    }
+    if (mem_size % block_size != 0)
+    {
+        fprintf(stderr, "Error: Memory size must be a multiple of the"
+                        " block size.\n");
+        exit(2);
+    }
+
+    if (cfg->mode != MODE_SC && !cache_config_valid(&cfg->cfg))
+        exit(2);
+}
+
+void cfg_list_init(sim_config_list* list)
+{
+    list->configs = 0;
+    list->num_configs = 0;
+    list->cap = 0;
+}
+
+static sim_config* cfg_list_push(sim_config_list* list)
+{
+    if (list->num_configs == list->cap)
+    {
+        list->cap = list->cap ? 2 * list->cap : 8;
+        list->configs = realloc(list->configs, list->cap * sizeof(sim_config));
+    }
+    return &list->configs[list->num_configs++];
+}
+
+// Splits the '/' separated values of key in place into values, which
+// starts out holding the single value 0 for "not given"
+static unsigned int split_values(const char* spec, const char* key,
+                                 char* str, char** values)
+{
+    unsigned int result = 0;
+    char* save;
+    char* value;
+    for (value = strtok_r(str, "/", &save); value != 0;
+         value = strtok_r(0, "/", &save))
+    {
+        if (result == CFG_MAX_VALUES)
+        {
+            fprintf(stderr, "Error: Too many values for %s in configuration"
+                            " %s.\n", key, spec);
+            exit(2);
+        }
+        values[result++] = value;
+    }
+    if (result == 0)
+    {
+        fprintf(stderr, "Error: No value for %s in configuration %s.\n",
+                key, spec);
+        exit(2);
+    }
+    return result;
+}
+
+void cfg_add_spec(sim_config_list* list, const char* spec, size_t block_size,
+                  size_t mem_size)
+{
+    char* copy = strdup(spec);
+    char* save;
+    char* mode_name = strtok_r(copy, ",", &save);
+    if (mode_name == 0)
+    {
+        fprintf(stderr, "Error: Empty configuration.\n");
+        exit(2);
+    }
+
+    // One list of values per key; a key that is not given keeps its default
+    char* sets[CFG_MAX_VALUES] = { 0 };
+    char* ways[CFG_MAX_VALUES] = { 0 };
+    char* blocks[CFG_MAX_VALUES] = { 0 };
+    char* policies[CFG_MAX_VALUES] = { 0 };
+    unsigned int num_sets = 1, num_ways = 1, num_blocks = 1, num_policies = 1;
+    char* inclusion = 0;
+    char* latency = 0;
+    char* write = 0;
+    char* alloc = 0;
+    char* prefetch = 0;
+    char* degree = 0;
+    char* distance = 0;
+    char* victim = 0;
+    char* misscache = 0;
+    char* field;
+    while ((field = strtok_r(0, ",", &save)) != 0)
+    {
+        char* value = strchr(field, '=');
+        if (value == 0)
+        {
+            fprintf(stderr, "Error: Expected key=value in configuration %s,"
+                            " got '%s'.\n", spec, field);
+            exit(2);
+        }
+        *value++ = '\0';
+        if (strcmp(field, "sets") == 0)
+            num_sets = split_values(spec, field, value, sets);
+        else if (strcmp(field, "ways") == 0)
+            num_ways = split_values(spec, field, value, ways);
+        else if (strcmp(field, "block") == 0)
+            num_blocks = split_values(spec, field, value, blocks);
+        else if (strcmp(field, "policy") == 0)
+            num_policies = split_values(spec, field, value, policies);
+        else if (strcmp(field, "incl") == 0)
+            inclusion = value;
+        else if (strcmp(field, "lat") == 0)
+            latency = value;
+        else if (strcmp(field, "write") == 0)
+            write = value;
+        else if (strcmp(field, "alloc") == 0)
+            alloc = value;
+        else if (strcmp(field, "prefetch") == 0)
+            prefetch = value;
+        else if (strcmp(field, "degree") == 0)
+            degree = value;
+        else if (strcmp(field, "distance") == 0)
+            distance = value;
+        else if (strcmp(field, "victim") == 0)
+            victim = value;
+        else if (strcmp(field, "misscache") == 0)
+            misscache = value;
+        else
+        {
+            fprintf(stderr, "Error: Unknown key %s in configuration %s.\n",
+                    field, spec);
+            exit(2);
+        }
+    }
+
+    unsigned int s, w, b, p;
+    for (s = 0; s < num_sets; s++)
+    for (w = 0; w < num_ways; w++)
+    for (b = 0; b < num_blocks; b++)
+    for (p = 0; p < num_policies; p++)
+    {
+        sim_config* cfg = cfg_list_push(list);
+        cfg_make(mode_name,
+                 sets[s] ? cfg_parse_count("sets", sets[s]) : 0,
+                 ways[w] ? cfg_parse_count("ways", ways[w]) : 0,
+                 blocks[b] ? cfg_parse_count("block", blocks[b]) : block_size,
+                 mem_size,
+                 policies[p] ? cfg_parse_policy(policies[p]) : 0,
+                 cfg);
+        if (inclusion)
+            cfg->cfg.inclusion = cfg_parse_inclusion(inclusion);
+        if (latency)
+            cfg->latency = cfg_parse_count("lat", latency);
+        cfg_set_write_policy(cfg, write, alloc);
+        cfg_set_prefetch(cfg, prefetch, degree, distance);
+        cfg_set_victim(cfg, victim, misscache);
+
+        // name the point by the keys that were given
+        free(cfg->name);
+        char* name;
+        size_t name_len;
+        FILE* name_file = open_memstream(&name, &name_len);
+        fputs(mode_name, name_file);
+        if (sets[s])
+            fprintf(name_file, ",sets=%s", sets[s]);
+        if (ways[w])
+            fprintf(name_file, ",ways=%s", ways[w]);
+        if (blocks[b])
+            fprintf(name_file, ",block=%s", blocks[b]);
+        if (policies[p])
+            fprintf(name_file, ",policy=%s", policies[p]);
+        if (inclusion)
+            fprintf(name_file, ",incl=%s", inclusion);
+        if (latency)
+            fprintf(name_file, ",lat=%s", latency);
+        if (write)
+            fprintf(name_file, ",write=%s", write);
+        if (alloc)
+            fprintf(name_file, ",alloc=%s", alloc);
+        if (prefetch)
+            fprintf(name_file, ",prefetch=%s", prefetch);
+        if (degree)
+            fprintf(name_file, ",degree=%s", degree);
+        if (distance)
+            fprintf(name_file, ",distance=%s", distance);
+        if (victim)
+            fprintf(name_file, ",victim=%s", victim);
+        if (misscache)
+            fprintf(name_file, ",misscache=%s", misscache);
+        fclose(name_file);
+        cfg->name = name;
+    }
+    free(copy);
+}
+
+void cfg_list_free(sim_config_list* list)
+{
+    unsigned int i;
+    for (i = 0; i < list->num_configs; i++)
+        free(list->configs[i].name);
+    free(list->configs);
+}
@@ -0,0 +1,91 @@
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include <stddef.h>
+
+#include "cache.h"
+
+#define MODE_SC 0
+#define MODE_DMC 1
+#define MODE_FAC 2
+#define MODE_SAC 3
+
+// Cycles per access of a cache level unless a spec gives lat=N
+#define CFG_DEFAULT_LATENCY 1
+
+// One cache model to simulate: the mode, its geometry and policy (ignored
+// for sc) and the block size of its main memory. latency only matters for
+// the levels of a hierarchy.
+typedef struct sim_config
+{
+    char* name;             // label for reports, owned by the config
+    int mode;
+    cache_config cfg;
+    size_t block_size;
+    unsigned int latency;
+} sim_config;
+
+// Growable list of configurations
+typedef struct sim_config_list
+{
+    sim_config* configs;
+    unsigned int num_configs;
+    unsigned int cap;
+} sim_config_list;
+
+// The functions below print an error and exit on bad input, since they
+// exist to turn command line arguments into configurations.
+
+// Parses a positive count given for flag
+size_t cfg_parse_count(const char* flag, const char* str);
+
+// Looks up a replacement policy by name
+const replacement_policy* cfg_parse_policy(const char* name);
+
+// Parses an inclusion policy name: nine, inclusive or exclusive
+int cfg_parse_inclusion(const char* name);
+
+// Sets the write policy of cfg from the names given, back or through for
+// write and yes or no for alloc; 0 keeps the default of write-back,
+// write-allocate
+void cfg_set_write_policy(sim_config* cfg, const char* write,
+                          const char* alloc);
+
+// Gives cfg the prefetcher called name, asking for degree blocks at a time
+// distance blocks ahead; 0 keeps no prefetcher, a degree of 1 and a
+// distance of 1
+void cfg_set_prefetch(sim_config* cfg, const char* name, const char* degree,
+                      const char* distance);
+
+// Gives cfg a victim cache of victim entries or a miss cache of misscache
+// entries; 0 keeps neither
+void cfg_set_victim(sim_config* cfg, const char* victim,
+                    const char* misscache);
+
+// Fills in cfg for mode_name with the given geometry (0 meaning the mode's
+// default). mem_size is the main memory size cfg will run against.
+void cfg_make(const char* mode_name, size_t sets, size_t ways,
+              size_t block_size, size_t mem_size,
+              const replacement_policy* policy, sim_config* cfg);
+
+// Usage text describing a spec, shared by main and sweep
+#define CFG_SPEC_HELP \
+    "SPEC is a mode followed by any of ,sets=N ,ways=N ,block=N" \
+    " ,policy=P; values may be lists like sets=1/2/4; and" \
+    " ,write=back|through ,alloc=yes|no ,prefetch=P ,degree=N" \
+    " ,distance=N ,victim=N ,misscache=N\n"
+
+// Appends the configurations of spec to list. A spec is a mode followed by
+// any of ,sets=N ,ways=N ,block=N and ,policy=P, where each value may be a
+// list such as sets=1/2/4 to get every combination, the single valued
+// ,write=back|through, ,alloc=yes|no, ,prefetch=P, ,degree=N,
+// ,distance=N, ,victim=N and ,misscache=N, and ,incl=I and ,lat=N for
+// hierarchy levels. The block size defaults to block_size.
+void cfg_add_spec(sim_config_list* list, const char* spec, size_t block_size,
+                  size_t mem_size);
+
+void cfg_list_init(sim_config_list* list);
+
+void cfg_list_free(sim_config_list* list);
+
+#endif
@@ -1,60 +1,62 @@
 #include <stdlib.h>
 
-#include "memory_block.h"
 #include "simple.h"
 
 simple_cache* sc_init(main_memory* mm)
 {
     simple_cache* result = malloc(sizeof(simple_cache));
-    result->mm = mm;
-    result->cs = cs_init();
+    sc_setup(result, mm);
     return result;
 };
 
+void sc_setup(simple_cache* result, main_memory* mm)
+{
+    result->mm = mm;
+    result->cs = cs_init();
+    addr_layout_init(&result->layout, mm->block_size, 1);
+    result->block = malloc(mm->block_size);
+}
+
 void sc_store_word(simple_cache* sc, void* addr, unsigned int val)
 {
     // Precompute start address of memory block
-    size_t addr_offt = (size_t) (addr - MAIN_MEMORY_START_ADDR) % MAIN_MEMORY_BLOCK_SIZE;
-    void* mb_start_addr = addr - addr_offt;
+    size_t addr_offt = addr_offset(&sc->layout, addr);
+    void* mb_start_addr = addr_block_start(&sc->layout, addr);
     
     // Load memory block from main memory
-    memory_block* mb = mm_read(sc->mm, mb_start_addr);
+    unsigned char* block = sc->block;
+    mm_read_into(sc->mm, mb_start_addr, block);
     
     // Update relevant word in memory block
-    unsigned int* mb_addr = mb->data + addr_offt;
+    unsigned int* mb_addr = (unsigned int*) (block + addr_offt);
     *mb_addr = val;
     
     // Story memory block back into main memory
-    mm_write(sc->mm, mb_start_addr, mb);
+    mm_write_from(sc->mm, mb_start_addr, block);
     
     // Update statistics
     ++sc->cs.w_queries;
     ++sc->cs.w_misses;
-    
-    // Free memory block
-    mb_free(mb);
 }
 
 unsigned int sc_load_word(simple_cache* sc, void* addr)
 {
     // Precompute start address of memory block
-    size_t addr_offt = (size_t) (addr - MAIN_MEMORY_START_ADDR) % MAIN_MEMORY_BLOCK_SIZE;
-    void* mb_start_addr = addr - addr_offt;
+    size_t addr_offt = addr_offset(&sc->layout, addr);
+    void* mb_start_addr = addr_block_start(&sc->layout, addr);
     
     // Load memory block from main memory
-    memory_block* mb = mm_read(sc->mm, mb_start_addr);
+    unsigned char* block = sc->block;
+    mm_read_into(sc->mm, mb_start_addr, block);
     
     // Extract the word we care about
-    unsigned int* mb_addr = mb->data + addr_offt;
+    unsigned int* mb_addr = (unsigned int*) (block + addr_offt);
     unsigned int result = *mb_addr;
     
     // Update statistics
     ++sc->cs.r_queries;
     ++sc->cs.r_misses;
     
-    // Free memory block
-    mb_free(mb);
-    
     // Return result
     return result;
 }
@@ -63,5 +65,11 @@ void sc_free(simple_cache* sc)
 {
     // Note: your cache free functions should NOT free main memory
     // Main memory is free'd by the main function after sc_free is called
+    sc_release(sc);
     free(sc);
-}
\ No newline at end of file
+}
+
+void sc_release(simple_cache* sc)
+{
+    free(sc->block);
+}
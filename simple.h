@@ -3,19 +3,27 @@
 
 #include "main_memory.h"
 #include "cache_stats.h"
+#include "address.h"
 
 typedef struct simple_cache
 {
     main_memory* mm;
     cache_stats cs;
+    addr_layout layout;
+    unsigned char* block;   // scratch copy of the block being accessed
 } simple_cache;
 
 simple_cache* sc_init(main_memory* mm);
 
+// Same as sc_init, but in caller-owned storage; undone by sc_release
+void sc_setup(simple_cache* sc, main_memory* mm);
+
 void sc_store_word(simple_cache* sc, void* addr, unsigned int val);
 
 unsigned int sc_load_word(simple_cache* sc, void* addr);
 
 void sc_free(simple_cache* sc);
 
+void sc_release(simple_cache* sc);
+
 #endif
\ No newline at end of file
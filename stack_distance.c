@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "stack_distance.h"
+
+// Initial time slots per set and table slots overall
+#define SD_MIN_CAP 64
+#define SD_MIN_TABLE 1024
+
+stack_distance* sd_init(size_t block_size, unsigned int num_sets)
+{
+    stack_distance* result = malloc(sizeof(stack_distance));
+    addr_layout_init(&result->layout, block_size, num_sets);
+
+    result->stacks = malloc(num_sets * sizeof(sd_stack));
+    unsigned int i;
+    for (i = 0; i < num_sets; i++)
+    {
+        sd_stack* st = &result->stacks[i];
+        st->cap = SD_MIN_CAP;
+        st->tree = calloc(st->cap + 1, sizeof(unsigned int));
+        st->owner = malloc((st->cap + 1) * sizeof(uintptr_t));
+        st->time = 0;
+        st->live = 0;
+    }
+
+    result->table_cap = SD_MIN_TABLE;
+    result->table_used = 0;
+    result->keys = calloc(result->table_cap, sizeof(uintptr_t));
+    result->times = malloc(result->table_cap * sizeof(unsigned int));
+
+    result->hist_cap = SD_MIN_CAP;
+    result->r_hist = calloc(result->hist_cap, sizeof(unsigned long long));
+    result->w_hist = calloc(result->hist_cap, sizeof(unsigned long long));
+    result->max_distance = 0;
+
+    result->r_queries = 0;
+    result->w_queries = 0;
+    result->r_cold = 0;
+    result->w_cold = 0;
+    return result;
+}
+
+static inline void fenwick_add(sd_stack* st, unsigned int t, int delta)
+{
+    for (; t <= st->cap; t += t & -t)
+        st->tree[t] += delta;
+}
+
+// Number of markers at times 1..t
+static inline unsigned int fenwick_sum(const sd_stack* st, unsigned int t)
+{
+    unsigned int result = 0;
+    for (; t > 0; t -= t & -t)
+        result += st->tree[t];
+    return result;
+}
+
+// Slot of block in the table: either its entry or the empty slot for it
+static inline size_t table_slot(const stack_distance* sd, uintptr_t block)
+{
+    uintptr_t key = block + 1;
+    size_t i = (key * (uintptr_t) 0x9E3779B97F4A7C15ull >> 17)
+               & (sd->table_cap - 1);
+    while (sd->keys[i] != 0 && sd->keys[i] != key)
+        i = (i + 1) & (sd->table_cap - 1);
+    return i;
+}
+
+static void table_grow(stack_distance* sd)
+{
+    uintptr_t* old_keys = sd->keys;
+    unsigned int* old_times = sd->times;
+    size_t old_cap = sd->table_cap;
+
+    sd->table_cap *= 2;
+    sd->keys = calloc(sd->table_cap, sizeof(uintptr_t));
+    sd->times = malloc(sd->table_cap * sizeof(unsigned int));
+    size_t i;
+    for (i = 0; i < old_cap; i++)
+    {
+        if (old_keys[i] == 0)
+            continue;
+        size_t slot = table_slot(sd, old_keys[i] - 1);
+        sd->keys[slot] = old_keys[i];
+        sd->times[slot] = old_times[i];
+    }
+    free(old_keys);
+    free(old_times);
+}
+
+// Renumbers the markers of st as 1..live, doubling the slots first if more
+// than half of them are live, and rebuilds the tree
+static void stack_compact(stack_distance* sd, sd_stack* st)
+{
+    unsigned int t;
+    unsigned int next = 0;
+    for (t = 1; t <= st->time; t++)
+    {
+        if (st->owner[t] == SD_NONE)
+            continue;
+        st->owner[++next] = st->owner[t];
+        sd->times[table_slot(sd, st->owner[t])] = next;
+    }
+    st->time = next;
+
+    if (2 * st->live > st->cap)
+    {
+        st->cap *= 2;
+        st->tree = realloc(st->tree, (st->cap + 1) * sizeof(unsigned int));
+        st->owner = realloc(st->owner, (st->cap + 1) * sizeof(uintptr_t));
+    }
+
+    // linear time Fenwick build over ones at 1..live
+    for (t = 1; t <= st->cap; t++)
+        st->tree[t] = t <= st->live;
+    for (t = 1; t <= st->cap; t++)
+    {
+        unsigned int parent = t + (t & -t);
+        if (parent <= st->cap)
+            st->tree[parent] += st->tree[t];
+    }
+}
+
+static void hist_add(stack_distance* sd, size_t distance, int write)
+{
+    if (distance >= sd->hist_cap)
+    {
+        size_t old_cap = sd->hist_cap;
+        while (distance >= sd->hist_cap)
+            sd->hist_cap *= 2;
+        sd->r_hist = realloc(sd->r_hist,
+                             sd->hist_cap * sizeof(unsigned long long));
+        sd->w_hist = realloc(sd->w_hist,
+                             sd->hist_cap * sizeof(unsigned long long));
+        memset(sd->r_hist + old_cap, 0,
+               (sd->hist_cap - old_cap) * sizeof(unsigned long long));
+        memset(sd->w_hist + old_cap, 0,
+               (sd->hist_cap - old_cap) * sizeof(unsigned long long));
+    }
+    if (write)
+        ++sd->w_hist[distance];
+    else
+        ++sd->r_hist[distance];
+    if (distance >= sd->max_distance)
+        sd->max_distance = distance + 1;
+}
+
+void sd_access(stack_distance* sd, uintptr_t addr, int write)
+{
+    addr_parts p;
+    addr_split(&sd->layout, (void*) addr, sd->layout.pow2, &p);
+    sd_stack* st = &sd->stacks[p.set];
+
+    if (write)
+        ++sd->w_queries;
+    else
+        ++sd->r_queries;
+
+    if (st->time == st->cap)
+        stack_compact(sd, st);
+    unsigned int now = ++st->time;
+    st->owner[now] = p.block;
+
+    size_t slot = table_slot(sd, p.block);
+    if (sd->keys[slot] == 0)
+    {
+        // first touch: a miss at every size
+        if (write)
+            ++sd->w_cold;
+        else
+            ++sd->r_cold;
+        ++st->live;
+        if (2 * (sd->table_used + 1) > sd->table_cap)
+        {
+            table_grow(sd);
+            slot = table_slot(sd, p.block);
+        }
+        sd->keys[slot] = p.block + 1;
+        ++sd->table_used;
+    }
+    else
+    {
+        unsigned int last = sd->times[slot];
+        hist_add(sd, fenwick_sum(st, now - 1) - fenwick_sum(st, last), write);
+        fenwick_add(st, last, -1);
+        st->owner[last] = SD_NONE;
+    }
+    sd->times[slot] = now;
+    fenwick_add(st, now, 1);
+}
+
+void sd_free(stack_distance* sd)
+{
+    unsigned int i;
+    for (i = 0; i < sd->layout.num_sets; i++)
+    {
+        free(sd->stacks[i].tree);
+        free(sd->stacks[i].owner);
+    }
+    free(sd->stacks);
+    free(sd->keys);
+    free(sd->times);
+    free(sd->r_hist);
+    free(sd->w_hist);
+    free(sd);
+}
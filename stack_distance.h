@@ -0,0 +1,61 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "address.h"
+
+// Marks a time slot whose block has been accessed again since
+#define SD_NONE UINTPTR_MAX
+
+// LRU stack of one set. Every block of the set has a marker at the time of
+// its most recent access; the stack distance of an access is the number of
+// markers after the block's previous one, counted with a Fenwick tree over
+// times. Times are renumbered once they run out, so the tree only has to
+// hold about as many slots as the set has distinct blocks.
+typedef struct sd_stack
+{
+    unsigned int* tree;     // Fenwick tree of live markers over times 1..cap
+    uintptr_t* owner;       // block of the marker at each time, or SD_NONE
+    unsigned int cap;
+    unsigned int time;      // last time handed out
+    unsigned int live;      // number of markers
+} sd_stack;
+
+// Mattson stack-distance analysis: one pass over a trace gives the hits of
+// an LRU cache of every number of ways at a fixed set count, at block
+// granularity. With one set that is every fully associative size.
+typedef struct stack_distance
+{
+    addr_layout layout;
+    sd_stack* stacks;
+
+    // Open addressing table from block number + 1 to the time of its marker
+    uintptr_t* keys;
+    unsigned int* times;
+    size_t table_cap;
+    size_t table_used;
+
+    // r_hist[d] and w_hist[d] count reads and writes at stack distance d,
+    // which hit in every cache of more than d ways
+    unsigned long long* r_hist;
+    unsigned long long* w_hist;
+    size_t hist_cap;
+    size_t max_distance;    // largest distance seen + 1
+
+    // Accesses and first touches (misses at every size)
+    unsigned long long r_queries;
+    unsigned long long w_queries;
+    unsigned long long r_cold;
+    unsigned long long w_cold;
+} stack_distance;
+
+stack_distance* sd_init(size_t block_size, unsigned int num_sets);
+
+// Records an access to addr; write is 1 for stores
+void sd_access(stack_distance* sd, uintptr_t addr, int write);
+
+void sd_free(stack_distance* sd);
+
+#endif
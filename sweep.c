@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "multi_sim.h"
+
+// Runs many cache configurations over one trace on several threads and
+// writes a CSV or JSON report. The trace is decoded once into a read-only
+// array shared by all threads; every configuration is simulated by a
+// single thread on its own cache and main memory copy.
+
+#define SWEEP_CSV 0
+#define SWEEP_JSON 1
+
+static const char* const mode_names[] = { "sc", "dmc", "fac", "sac" };
+
+typedef struct sweep_result
+{
+    cache_stats cs;
+    unsigned int mm_writes;
+    unsigned int mm_reads;
+    double cpu_seconds;
+} sweep_result;
+
+// Work-stealing deque of configuration indices. Each worker starts on its
+// own deque, taking the most expensive configuration first from the front,
+// and steals from the back of the others once its own runs dry. Tasks are
+// whole simulations, so a lock per deque costs nothing measurable.
+typedef struct task_deque
+{
+    pthread_mutex_t lock;
+    unsigned int* tasks;
+    unsigned int head;
+    unsigned int tail;
+} task_deque;
+
+typedef struct sweep
+{
+    const sim_config* configs;
+    const trace_record* records;
+    size_t num_records;
+    int image_fd;
+    size_t image_size;
+    size_t mem_size;
+
+    unsigned int num_workers;
+    task_deque* deques;
+    sweep_result* results;
+} sweep;
+
+typedef struct worker
+{
+    sweep* sw;
+    unsigned int id;
+} worker;
+
+static double now_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Rough relative cost of simulating cfg, used to start the slow ones first
+static double config_cost(const sim_config* cfg)
+{
+    if (cfg->mode == MODE_SC)
+        return 1;
+    // sets below the hash threshold scan their ways on every access
+    unsigned int ways = cfg->cfg.num_ways;
+    double scan = ways < CACHE_HASH_MIN_WAYS ? ways : CACHE_HASH_MIN_WAYS;
+    return scan + (double) cfg->cfg.num_sets * ways * cfg->block_size / 4096;
+}
+
+static const sim_config* sort_configs;
+
+static int by_cost(const void* a, const void* b)
+{
+    double ca = config_cost(&sort_configs[*(const unsigned int*) a]);
+    double cb = config_cost(&sort_configs[*(const unsigned int*) b]);
+    return (ca < cb) - (ca > cb);
+}
+
+static int pop_front(task_deque* d, unsigned int* task)
+{
+    pthread_mutex_lock(&d->lock);
+    int result = d->head < d->tail;
+    if (result)
+        *task = d->tasks[d->head++];
+    pthread_mutex_unlock(&d->lock);
+    return result;
+}
+
+static int steal_back(task_deque* d, unsigned int* task)
+{
+    pthread_mutex_lock(&d->lock);
+    int result = d->head < d->tail;
+    if (result)
+        *task = d->tasks[--d->tail];
+    pthread_mutex_unlock(&d->lock);
+    return result;
+}
+
+// Returns 0 once every deque is empty. No tasks are added after the start,
+// so one empty pass over all deques means the sweep is done.
+static int next_task(sweep* sw, unsigned int id, unsigned int* task)
+{
+    if (pop_front(&sw->deques[id], task))
+        return 1;
+    unsigned int i;
+    for (i = 1; i < sw->num_workers; i++)
+    {
+        if (steal_back(&sw->deques[(id + i) % sw->num_workers], task))
+            return 1;
+    }
+    return 0;
+}
+
+static void run_task(sweep* sw, unsigned int task)
+{
+    // CPU time, so oversubscribed threads do not inflate it
+    double start = now_seconds(CLOCK_THREAD_CPUTIME_ID);
+    multi_sim* ms = ms_init(&sw->configs[task], 1, sw->image_fd, sw->image_size,
+                            sw->mem_size);
+    sim_instance* sim = &ms->sims[0];
+    sim->mm.verbose = 0;
+    ms_run(ms, sw->records, sw->num_records);
+
+    sweep_result* result = &sw->results[task];
+    result->cs = sim->mode == MODE_SC ? sim->sc.cs : sim->c.cs;
+    result->mm_writes = sim->mm.w_queries;
+    result->mm_reads = sim->mm.r_queries;
+    ms_free(ms);
+    result->cpu_seconds = now_seconds(CLOCK_THREAD_CPUTIME_ID) - start;
+}
+
+static void* worker_main(void* arg)
+{
+    worker* w = arg;
+    unsigned int task;
+    while (next_task(w->sw, w->id, &task))
+        run_task(w->sw, task);
+    return 0;
+}
+
+static void print_report(FILE* out, int format, const sim_config* configs,
+                         const sweep_result* results, unsigned int num_configs)
+{
+    if (format == SWEEP_CSV)
+        fprintf(out, "config,mode,sets,ways,block,policy,reads,read_hits,"
+                     "writes,write_hits,hit_rate,mm_reads,mm_writes,"
+                     "cpu_seconds\n");
+    else
+        fprintf(out, "[\n");
+
+    unsigned int i;
+    for (i = 0; i < num_configs; i++)
+    {
+        const sim_config* cfg = &configs[i];
+        const sweep_result* r = &results[i];
+        int sc = cfg->mode == MODE_SC;
+        unsigned int sets = sc ? 0 : cfg->cfg.num_sets;
+        unsigned int ways = sc ? 0 : cfg->cfg.num_ways;
+        const char* policy = sc ? "none"
+                             : cfg->cfg.policy ? cfg->cfg.policy->name : "lru";
+        unsigned int r_hits = r->cs.r_queries - r->cs.r_misses;
+        unsigned int w_hits = r->cs.w_queries - r->cs.w_misses;
+        unsigned int queries = r->cs.r_queries + r->cs.w_queries;
+        double hit_rate = queries ? (double) (r_hits + w_hits) / queries : 0;
+
+        if (format == SWEEP_CSV)
+            fprintf(out, "\"%s\",%s,%u,%u,%zu,%s,%u,%u,%u,%u,%.6f,%u,%u,%.6f\n",
+                    cfg->name, mode_names[cfg->mode], sets, ways,
+                    cfg->block_size, policy, r->cs.r_queries, r_hits,
+                    r->cs.w_queries, w_hits, hit_rate, r->mm_reads,
+                    r->mm_writes, r->cpu_seconds);
+        else
+            fprintf(out, "  {\"config\": \"%s\", \"mode\": \"%s\", \"sets\": %u,"
+                         " \"ways\": %u, \"block\": %zu, \"policy\": \"%s\","
+                         " \"reads\": %u, \"read_hits\": %u, \"writes\": %u,"
+                         " \"write_hits\": %u, \"hit_rate\": %.6f,"
+                         " \"mm_reads\": %u, \"mm_writes\": %u,"
+                         " \"cpu_seconds\": %.6f}%s\n",
+                    cfg->name, mode_names[cfg->mode], sets, ways,
+                    cfg->block_size, policy, r->cs.r_queries, r_hits,
+                    r->cs.w_queries, w_hits, hit_rate, r->mm_reads,
+                    r->mm_writes, r->cpu_seconds,
+                    i + 1 < num_configs ? "," : "");
+    }
+
+    if (format == SWEEP_JSON)
+        fprintf(out, "]\n");
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [--threads N] [--format csv|json]"
+                    " [--output FILE] [--block N] [--mem N]"
+                    " --config SPEC [--config SPEC ...] input_file\n"
+                    CFG_SPEC_HELP
+                    "Policies: %s\n"
+                    "Prefetchers: %s\n", prog, repl_names(), pf_names());
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_threads = online > 0 ? online : 1;
+    int format = SWEEP_CSV;
+    const char* output_path = 0;
+    size_t block_size = MAIN_MEMORY_BLOCK_SIZE;
+    size_t mem_size = MAIN_MEMORY_SIZE;
+
+    const char** specs = malloc(argc * sizeof(char*));
+    unsigned int num_specs = 0;
+    const char* trace_path = 0;
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (i + 1 == argc)
+                usage(argv[0]);
+            if (strcmp(argv[i], "--threads") == 0)
+                num_threads = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--format") == 0)
+            {
+                if (strcmp(argv[i + 1], "csv") == 0)
+                    format = SWEEP_CSV;
+                else if (strcmp(argv[i + 1], "json") == 0)
+                    format = SWEEP_JSON;
+                else
+                    usage(argv[0]);
+            }
+            else if (strcmp(argv[i], "--output") == 0)
+                output_path = argv[i + 1];
+            else if (strcmp(argv[i], "--block") == 0)
+                block_size = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--mem") == 0)
+                mem_size = cfg_parse_count(argv[i], argv[i + 1]);
+            else if (strcmp(argv[i], "--config") == 0)
+                specs[num_specs++] = argv[i + 1];
+            else
+            {
+                fprintf(stderr, "Error: Unknown option %s.\n", argv[i]);
+                exit(2);
+            }
+            ++i;
+        }
+        else if (trace_path == 0)
+            trace_path = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (trace_path == 0 || num_specs == 0)
+        usage(argv[0]);
+
+    sim_config_list list;
+    cfg_list_init(&list);
+    for (i = 0; i < (int) num_specs; i++)
+        cfg_add_spec(&list, specs[i], block_size, mem_size);
+    unsigned int num_configs = list.num_configs;
+    if (num_threads > num_configs)
+        num_threads = num_configs;
+
+    FILE* out = stdout;
+    if (output_path)
+    {
+        out = fopen(output_path, "w");
+        if (out == 0)
+        {
+            fprintf(stderr, "Error: Could not create %s.\n", output_path);
+            exit(3);
+        }
+    }
+
+    sweep sw;
+    trace_record* records;
+    if (!trace_load(trace_path, &records, &sw.num_records))
+        exit(3);
+    size_t image_size;
+    int image_fd = mm_open_image(&image_size);
+    sw.configs = list.configs;
+    sw.records = records;
+    sw.image_fd = image_fd;
+    sw.image_size = image_size;
+    sw.mem_size = mem_size;
+    sw.num_workers = num_threads;
+    sw.results = calloc(num_configs, sizeof(sweep_result));
+
+    // Deal the configurations out most expensive first, round robin, so
+    // every worker starts with a similar mix
+    unsigned int* order = malloc(num_configs * sizeof(unsigned int));
+    unsigned int j;
+    for (j = 0; j < num_configs; j++)
+        order[j] = j;
+    sort_configs = list.configs;
+    qsort(order, num_configs, sizeof(unsigned int), by_cost);
+    sw.deques = malloc(num_threads * sizeof(task_deque));
+    for (j = 0; j < num_threads; j++)
+    {
+        task_deque* d = &sw.deques[j];
+        pthread_mutex_init(&d->lock, 0);
+        d->tasks = malloc((num_configs / num_threads + 1) * sizeof(unsigned int));
+        d->head = 0;
+        d->tail = 0;
+    }
+    for (j = 0; j < num_configs; j++)
+    {
+        task_deque* d = &sw.deques[j % num_threads];
+        d->tasks[d->tail++] = order[j];
+    }
+
+    double start = now_seconds(CLOCK_MONOTONIC);
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    worker* workers = malloc(num_threads * sizeof(worker));
+    for (j = 0; j < num_threads; j++)
+    {
+        workers[j].sw = &sw;
+        workers[j].id = j;
+        if (pthread_create(&threads[j], 0, worker_main, &workers[j]) != 0)
+        {
+            fprintf(stderr, "Error: Could not start thread %u.\n", j);
+            exit(4);
+        }
+    }
+    for (j = 0; j < num_threads; j++)
+        pthread_join(threads[j], 0);
+    double elapsed = now_seconds(CLOCK_MONOTONIC) - start;
+
+    double serial = 0;
+    for (j = 0; j < num_configs; j++)
+        serial += sw.results[j].cpu_seconds;
+    print_report(out, format, list.configs, sw.results, num_configs);
+    fprintf(stderr, "Swept %u configurations over %zu accesses in %.3f s"
+                    " on %zu threads (%.1fx their total CPU time).\n",
+            num_configs, sw.num_records, elapsed, num_threads,
+            elapsed > 0 ? serial / elapsed : 0);
+
+    if (output_path)
+        fclose(out);
+    for (j = 0; j < num_threads; j++)
+    {
+        pthread_mutex_destroy(&sw.deques[j].lock);
+        free(sw.deques[j].tasks);
+    }
+    free(sw.deques);
+    free(threads);
+    free(workers);
+    free(order);
+    free(sw.results);
+    close(image_fd);
+    free(records);
+    cfg_list_free(&list);
+    free(specs);
+
+    return 0;
+}
@@ -52,7 +52,7 @@ testlist=(
 
 #uncomment for dmc
 
-make all 
+make all trace_convert
 
 echo "checking dmc..."
 
@@ -106,4 +106,294 @@ else
 	echo "sac: all tests passed!"
 fi
 
+#write policies, write buffer and hierarchies: stats must match
+#tests/results_policy, and memory must match the simple cache's
+
+policytests=(
+	"wt_dmc w1 --write through dmc"
+	"na_sac w1 --alloc no sac"
+	"wtna_fac w1 --write through --alloc no --ways 4 fac"
+	"wb_sac w1 --write-buffer 2/1 sac"
+	"wtwb_dmc w1 --write through --write-buffer 4/2 dmc"
+	"hy_wt w1 --level sac,write=through --level dmc,sets=4"
+	"hy_incl w1 --level dmc,sets=4,alloc=no --level sac,sets=2,incl=inclusive"
+	"hy_excl w1 --level dmc,sets=2 --level fac,ways=4,incl=exclusive"
+	"hy_incl_dmc w2 --level fac,ways=4,alloc=no --level dmc,sets=1,incl=inclusive"
+	)
+
+#runs each "name trace args..." test of kind $1 quietly, comparing its
+#stats with tests/results_$1 and its memory with the simple cache's
+check_stats() {
+	local kind=$1
+	shift
+	mkdir -p tests/test_${kind}
+	local failed=0
+	local test name trace
+	for test in "$@"; do
+		set -- $test
+		name=$1
+		trace=tests/$2${t}
+		shift 2
+		./main --quiet --dump-memory tests/test_${kind}/${name}.data "$@" ${trace} > tests/test_${kind}/${name}${text}
+		./main --quiet --dump-memory tests/test_${kind}/${name}_sc.data sc ${trace} > /dev/null
+		if [[ $(diff tests/results_${kind}/${name}${text} tests/test_${kind}/${name}${text}) ]]; then
+			echo "${kind}: error in test $name"
+			failed=1
+		fi
+		if ! cmp -s tests/test_${kind}/${name}.data tests/test_${kind}/${name}_sc.data; then
+			echo "${kind}: memory differs in test $name"
+			failed=1
+		fi
+		rm tests/test_${kind}/${name}.data tests/test_${kind}/${name}_sc.data
+	done
+	if [[ $failed == 0 ]]; then
+		echo "${kind}: all tests passed!"
+	fi
+}
+
+echo "checking write policies and hierarchies..."
+
+check_stats policy "${policytests[@]}"
+
+#replacement policies: stats must match tests/results_replacement
+
+replacementtests=()
+for p in lru plru srrip brrip fifo random; do
+	replacementtests+=(
+		"${p}_sac w3 --policy $p sac"
+		"${p}_sac4 w3 --policy $p --sets 8 --ways 4 sac"
+		"${p}_fac w3 --policy $p --ways 8 fac"
+		"${p}_fac16 w3 --policy $p --ways 16 fac"
+		"${p}_wt t22 --policy $p --write through --ways 4 fac"
+		)
+done
+
+echo "checking replacement policies..."
+
+check_stats replacement "${replacementtests[@]}"
+
+#prefetchers: accuracy and coverage must match tests/results_prefetch
+
+prefetchtests=(
+	"next_dmc w3 --prefetch next dmc"
+	"next_sac t15 --prefetch next sac"
+	"stride_sac w3 --prefetch stride --prefetch-degree 2 sac"
+	"stride_fac t16 --prefetch stride --ways 4 fac"
+	"stream_sac w3 --prefetch stream --prefetch-distance 2 sac"
+	"stream_deg w3 --prefetch stream --prefetch-degree 4 --ways 4 sac"
+	"next_wt w1 --prefetch next --write through --alloc no sac"
+	)
+
+echo "checking prefetchers..."
+
+check_stats prefetch "${prefetchtests[@]}"
+
+#victim and miss caches: their hit rates must match tests/results_victim
+
+victimtests=(
+	"victim_dmc w3 --victim 2 dmc"
+	"victim4_dmc w1 --victim 4 dmc"
+	"victim_sac w3 --victim 4 --sets 8 --ways 2 sac"
+	"victim_wb w1 --victim 2 --write-buffer 2/1 dmc"
+	"miss_dmc w3 --miss-cache 2 dmc"
+	"miss4_dmc w1 --miss-cache 4 dmc"
+	"miss_sac w3 --miss-cache 4 --sets 8 --ways 2 sac"
+	)
+
+echo "checking victim and miss caches..."
+
+check_stats victim "${victimtests[@]}"
+
+#timing: cycles, AMAT, MLP and bus use must match tests/results_timing
+
+timingtests=(
+	"dmc_w3 w3 --timing dmc"
+	"sac_w3 w3 --timing sac"
+	"fac_t22 t22 --timing --ways 4 fac"
+	"mshr1_sac w3 --timing --mshrs 1 sac"
+	"mshr2_sac w3 --timing --mshrs 2 sac"
+	"bus_wt w1 --timing --write through --bus-cycles 4 --hit-latency 2 --mm-latency 50 dmc"
+	"pf_sac w3 --timing --prefetch stride sac"
+	"victim_dmc w3 --timing --victim 2 dmc"
+	)
+
+echo "checking timing..."
+
+check_stats timing "${timingtests[@]}"
+
+#quiet runs take the batched path and verbose runs go one access at a
+#time; the stats that end a verbose run must match the quiet run's
+
+verbosetests=(
+	"w3 dmc"
+	"w3 sac"
+	"w3 --ways 16 fac"
+	"w3 --sets 8 --ways 4 --policy plru sac"
+	"w3 --policy srrip --prefetch stride sac"
+	"w3 --victim 2 dmc"
+	"w3 --miss-cache 2 --timing dmc"
+	"w3 --write through --alloc no --write-buffer 4/2 sac"
+	"w3 --config sac,ways=4,prefetch=stream"
+	"t22 --ways 4 fac"
+	)
+
+echo "checking verbose against quiet..."
+
+mkdir -p tests/test_verbose
+failed=0
+for test in "${verbosetests[@]}"; do
+	set -- $test
+	trace=tests/$1${t}
+	shift
+	./main "$@" ${trace} | sed -n '/^\(Configuration: \|\*\*\*\*\)/,$p' > tests/test_verbose/verbose${text}
+	./main --quiet "$@" ${trace} > tests/test_verbose/quiet${text}
+	if [[ $(diff tests/test_verbose/verbose${text} tests/test_verbose/quiet${text}) ]]; then
+		echo "verbose: stats differ in test \"$test\""
+		failed=1
+	fi
+done
+rm -r tests/test_verbose
+
+if [[ $failed == 0 ]]; then
+	echo "verbose: all tests passed!"
+fi
+
+#multicore coherence: stats must match tests/results_mc, and a
+#deterministic threaded run must match the serial one exactly
+
+mctests=(
+	"mesi_rand --protocol mesi mc tests/t22.test tests/t23.test tests/t24.test"
+	"mesi_share --protocol mesi mc tests/w1.test tests/w1.test"
+	"mesi_w3 --protocol mesi --sets 4 --ways 2 mc tests/w3.test tests/w3.test tests/w1.test"
+	"moesi_share --protocol moesi mc tests/w1.test tests/w1.test"
+	"moesi_w3 --protocol moesi --sets 4 --ways 2 mc tests/w3.test tests/w3.test tests/w1.test"
+	"moesi_l2 --protocol moesi --sets 2 --ways 2 --l2 sac,sets=4 mc tests/w3.test tests/w3.test tests/w1.test"
+	)
+
+echo "checking multicore..."
+
+mkdir -p tests/test_mc
+failed=0
+for test in "${mctests[@]}"; do
+	set -- $test
+	name=$1
+	shift
+	./main --quiet --dump-memory tests/test_mc/${name}.data "$@" > tests/test_mc/${name}${text}
+	./main --quiet --threads 3 --deterministic --dump-memory tests/test_mc/${name}_mt.data "$@" > tests/test_mc/${name}_mt${text}
+	if [[ $(diff tests/results_mc/${name}${text} tests/test_mc/${name}${text}) ]]; then
+		echo "mc: error in test $name"
+		failed=1
+	fi
+	if [[ $(diff tests/test_mc/${name}${text} tests/test_mc/${name}_mt${text}) ]] \
+		|| ! cmp -s tests/test_mc/${name}.data tests/test_mc/${name}_mt.data; then
+		echo "mc: threaded run differs in test $name"
+		failed=1
+	fi
+	rm tests/test_mc/${name}.data tests/test_mc/${name}_mt.data tests/test_mc/${name}_mt${text}
+done
+
+if [[ $failed == 0 ]]; then
+	echo "mc: all tests passed!"
+fi
+
+#binary traces: every trace converted by trace_convert must simulate
+#exactly like its text
+
+echo "checking binary traces..."
+
+mkdir -p tests/test_binary
+failed=0
+for trace in tests/[tw]*${t}; do
+	name=$(basename ${trace} ${t})
+	./trace_convert ${trace} tests/test_binary/${name}.bin > /dev/null
+	for mode in dmc sac; do
+		./main ${mode} ${trace} > tests/test_binary/text${text}
+		./main ${mode} tests/test_binary/${name}.bin > tests/test_binary/binary${text}
+		if [[ $(diff tests/test_binary/text${text} tests/test_binary/binary${text}) ]]; then
+			echo "binary: ${mode} differs in test $name"
+			failed=1
+		fi
+	done
+done
+rm -r tests/test_binary
+
+if [[ $failed == 0 ]]; then
+	echo "binary: all tests passed!"
+fi
+
+#malformed traces: the warnings and stats must match tests/results_format,
+#trace_convert must warn about the same lines, and the records it keeps
+#must simulate like the text
+
+echo "checking format errors..."
+
+mkdir -p tests/test_format
+failed=0
+for trace in tests/f*${t}; do
+	name=$(basename ${trace} ${t})
+	./main --quiet sac ${trace} > tests/test_format/${name}${text} 2>&1
+	./main --quiet sac ${trace} 2> tests/test_format/main.err > tests/test_format/text${text}
+	./trace_convert ${trace} tests/test_format/${name}.bin 2> tests/test_format/convert.err > /dev/null
+	./main --quiet sac tests/test_format/${name}.bin > tests/test_format/binary${text}
+	if [[ $(diff tests/results_format/${name}${text} tests/test_format/${name}${text}) ]]; then
+		echo "format: error in test $name"
+		failed=1
+	fi
+	if [[ $(diff tests/test_format/main.err tests/test_format/convert.err) ]]; then
+		echo "format: trace_convert warns differently in test $name"
+		failed=1
+	fi
+	if [[ $(diff tests/test_format/text${text} tests/test_format/binary${text}) ]]; then
+		echo "format: binary trace differs in test $name"
+		failed=1
+	fi
+	rm tests/test_format/main.err tests/test_format/convert.err tests/test_format/text${text} \
+		tests/test_format/binary${text} tests/test_format/${name}.bin
+done
+
+if [[ $failed == 0 ]]; then
+	echo "format: all tests passed!"
+fi
+
+#stack distances: for every number of ways, sd's LRU hits must match a
+#cache of that many ways; sd lists a row only where the hits change
+
+echo "checking stack distances..."
+
+failed=0
+for name in t15 t20 t22 t23 t24 w1 w3; do
+	trace=tests/${name}${t}
+	for sets in 1 2 4; do
+		./main --sets ${sets} sd ${trace} > tests/sd${text}
+		for ways in 1 2 3 4 8 16; do
+			sd_hits=$(awk -v ways=${ways} '$1 ~ /^[0-9]+$/ && $1 <= ways { split($2, r, "/"); split($3, w, "/"); hits = r[1] " " w[1] }
+				END { print hits == "" ? "0 0" : hits }' tests/sd${text})
+			if [[ $sets == 1 ]]; then
+				./main --quiet --ways ${ways} fac ${trace} > tests/sd_cache${text}
+			else
+				./main --quiet --sets ${sets} --ways ${ways} sac ${trace} > tests/sd_cache${text}
+			fi
+			cache_hits="$(sed -n 's/^Read Hit Rate:.*(\([0-9]*\)\/.*/\1/p' tests/sd_cache${text}) $(sed -n 's/^Write Hit Rate:.*(\([0-9]*\)\/.*/\1/p' tests/sd_cache${text})"
+			if [[ "$sd_hits" != "$cache_hits" ]]; then
+				echo "sd: ${ways} ways of ${sets} sets differ in test $name ($sd_hits against $cache_hits)"
+				failed=1
+			fi
+		done
+	done
+done
+rm tests/sd${text} tests/sd_cache${text}
+
+if [[ $failed == 0 ]]; then
+	echo "sd: all tests passed!"
+fi
+
+#the tag compare has SSE2, AVX2 and scalar versions; rebuild with the
+#scalar one and rerun the tests that search sets of up to 16 ways
+
+echo "checking replacement policies with SIMD=off..."
+
+make -B SIMD=off main > /dev/null
+check_stats replacement "${replacementtests[@]}"
+make -B all > /dev/null
+
 exit 0
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <limits.h>
+
+#include "timing.h"
+
+timing* timing_init(const timing_config* cfg)
+{
+    timing* result = calloc(1, sizeof(timing));
+    result->cfg = *cfg;
+    result->mshrs = malloc(cfg->num_mshrs * sizeof(timing_mshr));
+    return result;
+}
+
+// Adds the outstanding misses up to cycle t to the MLP sums
+static void timing_advance(timing* tm, unsigned long long t)
+{
+    if (tm->num_busy)
+    {
+        tm->mshr_cycles += (t - tm->last_change) * tm->num_busy;
+        tm->miss_cycles += t - tm->last_change;
+    }
+    tm->last_change = t;
+}
+
+static void timing_push(timing* tm, unsigned long long done, uintptr_t block)
+{
+    unsigned int i = tm->num_busy++;
+    while (i > 0 && tm->mshrs[(i - 1) / 2].done > done)
+    {
+        tm->mshrs[i] = tm->mshrs[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    tm->mshrs[i].done = done;
+    tm->mshrs[i].block = block;
+}
+
+// Removes the MSHR that finishes first
+static void timing_pop(timing* tm)
+{
+    timing_mshr last = tm->mshrs[--tm->num_busy];
+    unsigned int i = 0;
+    for (;;)
+    {
+        unsigned int child = 2 * i + 1;
+        if (child >= tm->num_busy)
+            break;
+        if (child + 1 < tm->num_busy
+            && tm->mshrs[child + 1].done < tm->mshrs[child].done)
+            ++child;
+        if (tm->mshrs[child].done >= last.done)
+            break;
+        tm->mshrs[i] = tm->mshrs[child];
+        i = child;
+    }
+    tm->mshrs[i] = last;
+}
+
+// Frees the MSHRs whose data arrives by cycle t, in order
+static void timing_retire(timing* tm, unsigned long long t)
+{
+    while (tm->num_busy && tm->mshrs[0].done <= t)
+    {
+        timing_advance(tm, tm->mshrs[0].done);
+        timing_pop(tm);
+    }
+}
+
+// Returns the MSHR of block, or -1. There are few MSHRs, so a scan is as
+// fast as anything.
+static int timing_find(const timing* tm, uintptr_t block)
+{
+    unsigned int i;
+    for (i = 0; i < tm->num_busy; i++)
+    {
+        if (tm->mshrs[i].block == block)
+            return i;
+    }
+    return -1;
+}
+
+// Takes the bus for cycles cycles from cycle t on; returns the cycle the
+// transfer starts
+static unsigned long long timing_bus(timing* tm, unsigned long long t,
+                                     unsigned long long cycles)
+{
+    unsigned long long start = t > tm->bus_free ? t : tm->bus_free;
+    tm->bus_free = start + cycles;
+    return start;
+}
+
+// Moves count blocks over the bus from cycle t on; returns the cycle the
+// first one starts
+static unsigned long long timing_transfer(timing* tm,
+                                          unsigned long long t,
+                                          unsigned int count)
+{
+    tm->transfers += count;
+    return timing_bus(tm, t,
+                      (unsigned long long) count * tm->cfg.bus_cycles);
+}
+
+void timing_access(timing* tm, uintptr_t block, unsigned int reads,
+                   unsigned int pf_reads, unsigned int writes,
+                   unsigned int word_writes)
+{
+    unsigned long long issue = tm->now;
+    timing_retire(tm, issue);
+
+    unsigned long long done = issue + tm->cfg.hit_latency;
+    int mshr = timing_find(tm, block);
+    if (mshr >= 0)
+    {
+        // the block is on its way; the functional model already has it
+        ++tm->merges;
+        if (tm->mshrs[mshr].done > done)
+            done = tm->mshrs[mshr].done;
+    }
+    else if (reads)
+    {
+        ++tm->misses;
+        if (tm->num_busy == tm->cfg.num_mshrs)
+        {
+            tm->stall_cycles += tm->mshrs[0].done - issue;
+            issue = tm->mshrs[0].done;
+            timing_retire(tm, issue);
+        }
+        unsigned long long start
+            = timing_transfer(tm, issue + tm->cfg.hit_latency, 1);
+        done = start + tm->cfg.mm_latency;
+        timing_advance(tm, issue);
+        timing_push(tm, done, block);
+    }
+    if (pf_reads)
+        timing_transfer(tm, issue + tm->cfg.hit_latency, pf_reads);
+    if (writes)
+        timing_transfer(tm, issue, writes);
+    if (word_writes)
+    {
+        tm->word_transfers += word_writes;
+        timing_bus(tm, issue,
+                   (unsigned long long) word_writes * tm->cfg.word_cycles);
+    }
+
+    ++tm->accesses;
+    tm->latency += done - tm->now;
+    if (done > tm->end)
+        tm->end = done;
+    tm->now = issue + 1;
+}
+
+void timing_finish(timing* tm)
+{
+    timing_retire(tm, ULLONG_MAX);
+    if (tm->bus_free > tm->end)
+        tm->end = tm->bus_free;
+}
+
+double timing_amat(const timing* tm)
+{
+    return tm->accesses ? (double) tm->latency / tm->accesses : 0;
+}
+
+double timing_mlp(const timing* tm)
+{
+    return tm->miss_cycles ? (double) tm->mshr_cycles / tm->miss_cycles : 0;
+}
+
+double timing_bus_utilization(const timing* tm)
+{
+    double busy = (double) tm->transfers * tm->cfg.bus_cycles
+                  + (double) tm->word_transfers * tm->cfg.word_cycles;
+    return tm->end ? busy / tm->end : 0;
+}
+
+void timing_free(timing* tm)
+{
+    free(tm->mshrs);
+    free(tm);
+}
@@ -0,0 +1,96 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+// Defaults of the timing model; the main memory latency defaults to
+// HIERARCHY_MM_LATENCY
+#define TIMING_HIT_LATENCY 1
+#define TIMING_BUS_CYCLES 4
+#define TIMING_MSHRS 8
+
+typedef struct timing_config
+{
+    unsigned int hit_latency;   // cycles from issue to the end of a hit
+    unsigned int mm_latency;    // cycles from the start of a block read to
+                                // its data
+    unsigned int bus_cycles;    // cycles the bus is busy per block moved
+    unsigned int word_cycles;   // cycles it is busy per word written alone
+    unsigned int num_mshrs;     // misses that can be outstanding at once
+} timing_config;
+
+// A miss waiting for main memory
+typedef struct timing_mshr
+{
+    unsigned long long done;    // cycle its data arrives
+    uintptr_t block;
+} timing_mshr;
+
+// Timing of a cache run, fed one access at a time after the functional
+// model has run it. Accesses issue in order, one per cycle, and do not wait
+// for each other: a hit takes hit_latency cycles, and a read from main
+// memory takes an MSHR until its data arrives. Accesses to a block with an
+// outstanding miss merge into its MSHR and finish with it. When every MSHR
+// is busy, a new miss stalls issue until the first one frees. Block reads
+// and writes share one bus, which moves a block every bus_cycles cycles
+// and a word stored through or around the cache every word_cycles; writes
+// are buffered, so nothing waits for them.
+typedef struct timing
+{
+    timing_config cfg;
+
+    unsigned long long now;         // issue cycle of the next access
+    unsigned long long bus_free;    // first cycle the bus is idle
+    unsigned long long end;         // last cycle an access finished
+
+    // Outstanding misses, a min-heap by done
+    timing_mshr* mshrs;
+    unsigned int num_busy;
+
+    // Outstanding misses summed over each cycle, and the cycles with any
+    unsigned long long mshr_cycles;
+    unsigned long long miss_cycles;
+    unsigned long long last_change; // cycle num_busy last changed
+
+    unsigned long long latency;     // cycles of all accesses, issue to end
+    unsigned long long stall_cycles;// issue cycles lost to full MSHRs
+    unsigned int accesses;
+    unsigned int misses;            // block reads that took an MSHR
+    unsigned int merges;            // accesses that joined a busy MSHR
+    unsigned int transfers;         // blocks moved over the bus
+    unsigned int word_transfers;    // single words written over it
+} timing;
+
+timing* timing_init(const timing_config* cfg);
+
+// Times the next access, to block number block. reads is the number of
+// block reads from main memory it made for itself (0 or 1), pf_reads the
+// number made for prefetches, writes the number of block writes and
+// word_writes the number of single words written. Prefetch reads only take
+// the bus.
+void timing_access(timing* tm, uintptr_t block, unsigned int reads,
+                   unsigned int pf_reads, unsigned int writes,
+                   unsigned int word_writes);
+
+// Lets the outstanding misses finish at the end of the run
+void timing_finish(timing* tm);
+
+// Cycles from the first issue to the last access or transfer
+static inline unsigned long long timing_cycles(const timing* tm)
+{
+    return tm->end;
+}
+
+// Average cycles per access, from issue to end
+double timing_amat(const timing* tm);
+
+// Memory-level parallelism: the average number of outstanding misses over
+// the cycles with at least one
+double timing_mlp(const timing* tm);
+
+// Share of the cycles the bus was busy
+double timing_bus_utilization(const timing* tm);
+
+void timing_free(timing* tm);
+
+#endif
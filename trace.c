@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "trace.h"
+
+// Character classes for the text parser: 1 + the value of a hex digit,
+// CH_SPACE for whitespace other than newline, 0 for everything else
+#define CH_SPACE 17
+
+static const unsigned char char_class[256] = {
+    ['\t'] = CH_SPACE, ['\v'] = CH_SPACE, ['\f'] = CH_SPACE,
+    ['\r'] = CH_SPACE, [' '] = CH_SPACE,
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+// The parsers below never look past the newline that ends the current line:
+// newline is neither a digit nor in CH_SPACE, so every scan stops at it.
+// That makes bounds checks unnecessary as long as each line is complete.
+
+static inline const char* skip_space(const char* p)
+{
+    while (char_class[(unsigned char) *p] == CH_SPACE)
+        ++p;
+    return p;
+}
+
+// Parses an optionally signed hex number with an optional 0x prefix, like
+// scanf's %p. Saturates on overflow as strtoul does.
+static inline int parse_hex(const char** pos, uintptr_t* result)
+{
+    const char* p = *pos;
+    int negative = 0;
+    if (*p == '+' || *p == '-')
+        negative = *p++ == '-';
+
+    // the 0 of a 0x prefix counts as a digit even if no hex digits follow
+    int prefix = p[0] == '0' && (p[1] == 'x' || p[1] == 'X');
+    if (prefix)
+        p += 2;
+
+    uintptr_t v = 0;
+    int overflow = 0;
+    const char* digits = p;
+    unsigned int cls;
+    while ((cls = char_class[(unsigned char) *p] - 1) < 16)
+    {
+        overflow |= (v >> (sizeof(v) * 8 - 4)) != 0;
+        v = v << 4 | cls;
+        ++p;
+    }
+    if (p == digits && !prefix)
+        return 0;
+    if (overflow)
+        v = UINTPTR_MAX;
+    else if (negative)
+        v = -v;
+
+    *pos = p;
+    *result = v;
+    return 1;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TRACE_SWAR_DIGITS 1
+
+// 1 if all eight bytes of chunk are ASCII digits
+static inline int all_digits8(uint64_t chunk)
+{
+    return ((chunk & 0xF0F0F0F0F0F0F0F0)
+            | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+           == 0x3333333333333333;
+}
+
+// Value of eight ASCII digits, the first in the lowest byte
+static inline uint64_t value_digits8(uint64_t chunk)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    chunk -= 0x3030303030303030;
+    chunk = chunk * 10 + (chunk >> 8);
+    return ((chunk & mask) * (100 + (1000000ull << 32))
+            + ((chunk >> 16) & mask) * (1 + (10000ull << 32))) >> 32;
+}
+#endif
+
+// Parses an optionally signed decimal number into an int, like scanf's %d
+static inline int parse_dec(const char** pos, uint32_t* result)
+{
+    const char* p = *pos;
+    int negative = 0;
+    if (*p == '+' || *p == '-')
+        negative = *p++ == '-';
+
+    // strtol saturates at the long range, then the value is truncated to int
+    uint64_t v = 0;
+    uint64_t limit = negative ? (uint64_t) INT64_MAX + 1 : INT64_MAX;
+    const char* digits = p;
+    unsigned int d;
+#ifdef TRACE_SWAR_DIGITS
+    // eight digits at a time; the buffer is padded so this may read past
+    // the end of the line
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+    if (all_digits8(chunk))
+    {
+        v = value_digits8(chunk);
+        p += 8;
+    }
+#endif
+    while ((d = (unsigned char) *p - '0') < 10)
+    {
+        ++p;
+        // below 2^59 another digit cannot reach the limit
+        if (v < (uint64_t) 1 << 59)
+            v = v * 10 + d;
+        else if (v > (limit - d) / 10)
+            v = limit;
+        else
+            v = v * 10 + d;
+    }
+    if (p == digits)
+        return 0;
+
+    *pos = p;
+    *result = (uint32_t) (negative ? -v : v);
+    return 1;
+}
+
+// Returns the first newline in [p, end), or 0 if there is none
+static inline const char* find_newline(const char* p, const char* end)
+{
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (end - p >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) p);
+        unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    for (; p < end; ++p)
+    {
+        if (*p == '\n')
+            return p;
+    }
+    return 0;
+}
+
+// Parses the line at line, which ends with a newline before end, into r.
+// Returns a TRACE_LINE_* code and sets *next to the start of the next line.
+// Accepts exactly what sscanf(line, "%c %p %d", ...) used to.
+static inline int parse_line(const char* line, const char* end,
+                             const char** next, trace_record* r)
+{
+    char RW = line[0];
+    const char* p = line + 1;
+    int status;
+
+    if (RW == '\n')
+    {
+        *next = p;
+        return TRACE_LINE_SKIP;
+    }
+    if (RW == '#')
+        status = TRACE_LINE_SKIP;
+    else if (RW != 'R' && RW != 'W')
+        status = TRACE_LINE_ERROR;
+    else
+    {
+        int tolkens_found = 1;
+        p = skip_space(p);
+        if (parse_hex(&p, &r->addr))
+        {
+            ++tolkens_found;
+            p = skip_space(p);
+            if (parse_dec(&p, &r->val))
+                ++tolkens_found;
+        }
+
+        if ((RW == 'R' && tolkens_found != 2) || (RW == 'W' && tolkens_found != 3))
+            status = TRACE_LINE_ERROR;
+        else
+        {
+            r->op = RW == 'W' ? TRACE_WRITE : TRACE_READ;
+            if (RW == 'R')
+                r->val = 0;
+            status = TRACE_LINE_RECORD;
+        }
+    }
+
+    // well-formed lines end right where parsing stopped
+    if (*p != '\n')
+        p = find_newline(p, end);
+    *next = p + 1;
+    return status;
+}
+
+int ttr_open(trace_text_reader* ttr, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    ttr_init_fd(ttr, fd);
+    return 1;
+}
+
+void ttr_init_fd(trace_text_reader* ttr, int fd)
+{
+    ttr->fd = fd;
+    ttr->cap = TRACE_TEXT_BUFFER_SIZE;
+    ttr->buf = calloc(ttr->cap + TRACE_TEXT_PADDING, 1);
+    ttr->pos = 0;
+    ttr->lines_end = 0;
+    ttr->len = 0;
+    ttr->eof = 0;
+    ttr->line_num = 0;
+}
+
+// Moves the unparsed tail of the buffer to the front, reads more after it
+// and finds the end of the last complete line
+static void ttr_refill(trace_text_reader* ttr)
+{
+    memmove(ttr->buf, ttr->buf + ttr->pos, ttr->len - ttr->pos);
+    ttr->len -= ttr->pos;
+    ttr->pos = 0;
+
+    // a single line longer than the buffer
+    if (ttr->len == ttr->cap)
+    {
+        ttr->cap *= 2;
+        ttr->buf = realloc(ttr->buf, ttr->cap + TRACE_TEXT_PADDING);
+        memset(ttr->buf + ttr->cap, 0, TRACE_TEXT_PADDING);
+    }
+
+    ssize_t n;
+    do
+        n = read(ttr->fd, ttr->buf + ttr->len, ttr->cap - ttr->len);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        // terminate a last line that has no newline in the padding
+        ttr->eof = 1;
+        if (ttr->len > 0)
+            ttr->buf[ttr->len] = '\n';
+        ttr->lines_end = ttr->len > 0 ? ttr->len + 1 : 0;
+        return;
+    }
+    ttr->len += n;
+
+    const char* last = memrchr(ttr->buf, '\n', ttr->len);
+    ttr->lines_end = last ? last + 1 - ttr->buf : 0;
+}
+
+int ttr_next(trace_text_reader* ttr, trace_record* r)
+{
+    for (;;)
+    {
+        if (ttr->pos >= ttr->lines_end)
+        {
+            if (ttr->eof)
+                return 0;
+            ttr_refill(ttr);
+            continue;
+        }
+
+        const char* line = ttr->buf + ttr->pos;
+        const char* next;
+        int status = parse_line(line, ttr->buf + ttr->lines_end, &next, r);
+        size_t line_len = next - line;
+        ttr->pos += line_len;
+        ++ttr->line_num;
+
+        // the newline of a last, unterminated line is not part of the file
+        if (ttr->pos > ttr->len)
+        {
+            --line_len;
+            // a lone character was skipped as an empty line
+            if (line_len == 1)
+                continue;
+        }
+
+        if (status == TRACE_LINE_RECORD)
+            return 1;
+        if (status == TRACE_LINE_ERROR)
+        {
+            fprintf(stderr, "Warning: Format error on line %d: ", ttr->line_num);
+            fwrite(line, 1, line_len, stderr);
+        }
+    }
+}
+
+void ttr_close(trace_text_reader* ttr)
+{
+    close(ttr->fd);
+    free(ttr->buf);
+}
+
+int trace_is_binary(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == 0)
+        return 0;
+    char magic[4];
+    int result = fread(magic, 4, 1, file) == 1
+                 && memcmp(magic, TRACE_MAGIC, 4) == 0;
+    fclose(file);
+    return result;
+}
+
+static void tw_header(trace_writer* tw)
+{
+    uint32_t version = TRACE_VERSION;
+    fwrite(TRACE_MAGIC, 4, 1, tw->file);
+    fwrite(&version, sizeof(version), 1, tw->file);
+    fwrite(&tw->count, sizeof(tw->count), 1, tw->file);
+}
+
+trace_writer* tw_open(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == 0)
+        return 0;
+
+    trace_writer* result = malloc(sizeof(trace_writer));
+    result->file = file;
+    result->count = 0;
+    result->prev_addr = 0;
+    result->used = 0;
+    tw_header(result);
+    return result;
+}
+
+static void tw_flush(trace_writer* tw)
+{
+    if (tw->used && fwrite(tw->buf, tw->used, 1, tw->file) != 1)
+    {
+        fprintf(stderr, "Error: Could not write the trace.\n");
+        exit(4);
+    }
+    tw->used = 0;
+}
+
+static inline void tw_varint(trace_writer* tw, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        tw->buf[tw->used++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    tw->buf[tw->used++] = (unsigned char) v;
+}
+
+void tw_append(trace_writer* tw, const trace_record* r)
+{
+    // a record is at most two 10-byte varints
+    if (sizeof(tw->buf) - tw->used < 20)
+        tw_flush(tw);
+
+    int64_t delta = (int64_t) (r->addr - tw->prev_addr);
+    tw_varint(tw, trace_zigzag(delta) << 1 | r->op);
+    if (r->op == TRACE_WRITE)
+        tw_varint(tw, trace_zigzag((int32_t) r->val));
+    tw->prev_addr = r->addr;
+    ++tw->count;
+}
+
+void tw_close(trace_writer* tw)
+{
+    tw_flush(tw);
+    rewind(tw->file);
+    tw_header(tw);
+    fclose(tw->file);
+    free(tw);
+}
+
+int tm_open(trace_map* tm, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < TRACE_HEADER_SIZE)
+    {
+        fprintf(stderr, "Error: %s is too short to be a binary trace.\n", path);
+        close(fd);
+        return 0;
+    }
+
+    tm->size = st.st_size;
+    tm->map = mmap(0, tm->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (tm->map == MAP_FAILED)
+    {
+        fprintf(stderr, "Error: Could not map %s.\n", path);
+        return 0;
+    }
+    madvise(tm->map, tm->size, MADV_SEQUENTIAL);
+
+    const unsigned char* base = tm->map;
+    uint32_t version;
+    memcpy(&version, base + 4, sizeof(version));
+    if (memcmp(base, TRACE_MAGIC, 4) != 0 || version != TRACE_VERSION)
+    {
+        fprintf(stderr, "Error: %s is not a version %d binary trace.\n", path,
+                TRACE_VERSION);
+        munmap(tm->map, tm->size);
+        return 0;
+    }
+    memcpy(&tm->remaining, base + 8, sizeof(tm->remaining));
+    tm->pos = base + TRACE_HEADER_SIZE;
+    tm->end = base + tm->size;
+    tm->prev_addr = 0;
+    return 1;
+}
+
+void tm_close(trace_map* tm)
+{
+    munmap(tm->map, tm->size);
+}
+
+int tr_open(trace_reader* tr, const char* path)
+{
+    tr->path = path;
+    tr->binary = trace_is_binary(path);
+    if (tr->binary)
+        return tm_open(&tr->tm, path);
+    if (!ttr_open(&tr->ttr, path))
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+void tr_close(trace_reader* tr)
+{
+    if (tr->binary)
+        tm_close(&tr->tm);
+    else
+        ttr_close(&tr->ttr);
+}
+
+int trace_load(const char* path, trace_record** records, size_t* num_records)
+{
+    trace_reader tr;
+    if (!tr_open(&tr, path))
+        return 0;
+
+    size_t cap = 1 << 16;
+    size_t n = 0;
+    trace_record* result = malloc(cap * sizeof(trace_record));
+    for (;;)
+    {
+        if (n == cap)
+        {
+            cap *= 2;
+            result = realloc(result, cap * sizeof(trace_record));
+        }
+        if (!tr_next(&tr, &result[n]))
+            break;
+        ++n;
+    }
+    tr_close(&tr);
+
+    *records = result;
+    *num_records = n;
+    return 1;
+}
@@ -0,0 +1,200 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Operations in a trace
+#define TRACE_READ 0
+#define TRACE_WRITE 1
+
+// One access of a trace
+typedef struct trace_record
+{
+    uintptr_t addr;
+    uint32_t val;           // value stored, unused for reads
+    uint8_t op;             // TRACE_READ or TRACE_WRITE
+} trace_record;
+
+// Text traces have one access per line: "R addr" or "W addr val", with the
+// address in hex and the value in decimal. Lines starting with '#' and empty
+// lines are skipped.
+
+// Results of parsing one line
+#define TRACE_LINE_RECORD 0
+#define TRACE_LINE_SKIP 1
+#define TRACE_LINE_ERROR 2
+
+#define TRACE_TEXT_BUFFER_SIZE (1 << 20)
+
+// Bytes allocated past the end of the buffer: room for a newline after an
+// unterminated last line and for word-sized reads past the end of a line
+#define TRACE_TEXT_PADDING 16
+
+// Streaming text trace reader over large read() buffers. Lines are parsed
+// in place with a hand-written parser that accepts exactly what
+// sscanf(line, "%c %p %d", ...) used to.
+typedef struct trace_text_reader
+{
+    int fd;
+    char* buf;
+    size_t cap;
+    size_t pos;             // start of the unparsed bytes in buf
+    size_t lines_end;       // end of the last complete line in buf
+    size_t len;             // end of the valid bytes in buf
+    int eof;
+    unsigned int line_num;
+} trace_text_reader;
+
+// Opens the text trace at path, returning 0 if it cannot be read
+int ttr_open(trace_text_reader* ttr, const char* path);
+
+// Starts reading a text trace from fd, which is closed by ttr_close
+void ttr_init_fd(trace_text_reader* ttr, int fd);
+
+// Reads the next record into r. Returns 1 on success and 0 at the end of the
+// trace. Malformed lines are reported on stderr and skipped.
+int ttr_next(trace_text_reader* ttr, trace_record* r);
+
+void ttr_close(trace_text_reader* ttr);
+
+// Binary traces start with a header of TRACE_MAGIC, the 32-bit
+// TRACE_VERSION and the 64-bit record count, all in host byte order.
+// Each record is then
+//   varint(zigzag(addr - previous addr) << 1 | op)
+//   varint(zigzag(val))                       for writes only
+// where varints are LEB128: 7 bits per byte, low bits first, high bit set on
+// every byte but the last.
+
+#define TRACE_MAGIC "CSTR"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+
+// Returns 1 if path starts with TRACE_MAGIC
+int trace_is_binary(const char* path);
+
+// Buffered writer for binary traces
+typedef struct trace_writer
+{
+    FILE* file;
+    uint64_t count;
+    uintptr_t prev_addr;
+    size_t used;
+    unsigned char buf[1 << 16];
+} trace_writer;
+
+// Returns 0 if path cannot be created
+trace_writer* tw_open(const char* path);
+
+void tw_append(trace_writer* tw, const trace_record* r);
+
+// Flushes, fills in the record count and closes the file
+void tw_close(trace_writer* tw);
+
+// Memory-mapped reader for binary traces. Records are decoded straight out
+// of the mapping, with no copying or per-record allocation.
+typedef struct trace_map
+{
+    void* map;
+    size_t size;
+    const unsigned char* pos;
+    const unsigned char* end;
+    uintptr_t prev_addr;
+    uint64_t remaining;
+} trace_map;
+
+// Maps the binary trace at path, returning 0 and printing an error on failure
+int tm_open(trace_map* tm, const char* path);
+
+// Decodes one LEB128 varint at *pos, or returns 0 if it runs past end
+static inline int tm_varint(const unsigned char** pos, const unsigned char* end,
+                            uint64_t* result)
+{
+    const unsigned char* p = *pos;
+    uint64_t v = 0;
+    unsigned int shift = 0;
+    while (p < end && shift < 64)
+    {
+        unsigned char byte = *p++;
+        v |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *pos = p;
+            *result = v;
+            return 1;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+static inline int64_t trace_unzigzag(uint64_t v)
+{
+    return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static inline uint64_t trace_zigzag(int64_t v)
+{
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+// Decodes the next record into r. Returns 1 on success, 0 at the end of the
+// trace and -1 if the trace is truncated or corrupt.
+static inline int tm_next(trace_map* tm, trace_record* r)
+{
+    if (tm->remaining == 0)
+        return 0;
+
+    uint64_t head;
+    if (!tm_varint(&tm->pos, tm->end, &head))
+        return -1;
+    r->op = head & 1;
+    r->addr = tm->prev_addr + (uintptr_t) trace_unzigzag(head >> 1);
+    tm->prev_addr = r->addr;
+
+    if (r->op == TRACE_WRITE)
+    {
+        uint64_t val;
+        if (!tm_varint(&tm->pos, tm->end, &val))
+            return -1;
+        r->val = (uint32_t) trace_unzigzag(val);
+    }
+    --tm->remaining;
+    return 1;
+}
+
+void tm_close(trace_map* tm);
+
+// Reads either kind of trace, picking by the file's header
+typedef struct trace_reader
+{
+    const char* path;
+    int binary;
+    trace_map tm;
+    trace_text_reader ttr;
+} trace_reader;
+
+// Opens the trace at path, printing an error and returning 0 if it cannot
+// be read
+int tr_open(trace_reader* tr, const char* path);
+
+// Reads the next record into r. Returns 1 on success and 0 at the end of the
+// trace; a truncated binary trace ends early with a warning.
+static inline int tr_next(trace_reader* tr, trace_record* r)
+{
+    if (!tr->binary)
+        return ttr_next(&tr->ttr, r);
+    int status = tm_next(&tr->tm, r);
+    if (status < 0)
+        fprintf(stderr, "Warning: %s is truncated.\n", tr->path);
+    return status == 1;
+}
+
+void tr_close(trace_reader* tr);
+
+// Decodes the whole text or binary trace at path into a malloc'd array of
+// *num_records records. Returns 0 if the trace cannot be read.
+int trace_load(const char* path, trace_record** records, size_t* num_records);
+
+#endif
@@ -0,0 +1,39 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+// Converts a text trace to the binary trace format read by main
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s input_file output_file\n", argv[0]);
+        exit(1);
+    }
+
+    trace_text_reader ttr;
+    if (!ttr_open(&ttr, argv[1]))
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", argv[1]);
+        exit(3);
+    }
+    trace_writer* tw = tw_open(argv[2]);
+    if (tw == 0)
+    {
+        fprintf(stderr, "Error: Could not create %s.\n", argv[2]);
+        exit(3);
+    }
+
+    trace_record r;
+    while (ttr_next(&ttr, &r))
+        tw_append(tw, &r);
+    ttr_close(&ttr);
+
+    printf("Wrote %llu records to %s.\n", (unsigned long long) tw->count,
+           argv[2]);
+    tw_close(tw);
+
+    return 0;
+}
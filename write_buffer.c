@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "write_buffer.h"
+
+write_buffer* wb_init(unsigned int num_entries, unsigned int batch,
+                      size_t block_size)
+{
+    write_buffer* result = malloc(sizeof(write_buffer));
+    result->num_entries = num_entries;
+    result->batch = batch;
+    result->block_size = block_size;
+    result->head = 0;
+    result->count = 0;
+    result->starts = malloc(num_entries * sizeof(void*));
+    result->data = malloc(num_entries * block_size);
+    result->mask = malloc(num_entries * block_size);
+    result->stores = 0;
+    result->merges = 0;
+    return result;
+}
+
+int wb_find(const write_buffer* wb, void* start_addr)
+{
+    unsigned int i;
+    unsigned int entry = wb->head;
+    for (i = 0; i < wb->count; i++)
+    {
+        if (wb->starts[entry] == start_addr)
+            return entry;
+        if (++entry == wb->num_entries)
+            entry = 0;
+    }
+    return -1;
+}
+
+int wb_push(write_buffer* wb, void* start_addr)
+{
+    unsigned int entry = wb->head + wb->count++;
+    if (entry >= wb->num_entries)
+        entry -= wb->num_entries;
+    wb->starts[entry] = start_addr;
+    memset(wb_mask(wb, entry), 0, wb->block_size);
+    return entry;
+}
+
+void wb_pop(write_buffer* wb)
+{
+    if (++wb->head == wb->num_entries)
+        wb->head = 0;
+    --wb->count;
+}
+
+int wb_covers(const write_buffer* wb, int entry)
+{
+    return memchr(wb_mask(wb, entry), 0, wb->block_size) == 0;
+}
+
+void wb_free(write_buffer* wb)
+{
+    free(wb->starts);
+    free(wb->data);
+    free(wb->mask);
+    free(wb);
+}
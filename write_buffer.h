@@ -0,0 +1,61 @@
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stddef.h>
+
+// Coalescing write buffer: a FIFO of up to num_entries blocks, each with a
+// mask of the bytes stored to it. Stores to a block that is already in the
+// buffer merge into its entry. Entries are found by a scan, so the buffer is
+// meant to stay small, like the hardware it models.
+typedef struct write_buffer
+{
+    unsigned int num_entries;
+    unsigned int batch;         // entries drained at once when full
+    size_t block_size;
+
+    // Ring of entries, oldest first from head
+    unsigned int head;
+    unsigned int count;
+    void** starts;              // start address of the block of each entry
+    unsigned char* data;        // num_entries blocks of block_size bytes
+    unsigned char* mask;        // 1 for each byte stored, per entry
+
+    unsigned int stores;        // stores taken
+    unsigned int merges;        // stores that went into an existing entry
+} write_buffer;
+
+write_buffer* wb_init(unsigned int num_entries, unsigned int batch,
+                      size_t block_size);
+
+// Returns the entry holding the block starting at start_addr, or -1
+int wb_find(const write_buffer* wb, void* start_addr);
+
+// Adds an empty entry for the block starting at start_addr and returns it.
+// The buffer must not be full.
+int wb_push(write_buffer* wb, void* start_addr);
+
+// Returns the oldest entry; the buffer must not be empty
+static inline int wb_oldest(const write_buffer* wb)
+{
+    return wb->head;
+}
+
+// Removes the oldest entry
+void wb_pop(write_buffer* wb);
+
+static inline unsigned char* wb_data(const write_buffer* wb, int entry)
+{
+    return wb->data + (size_t) entry * wb->block_size;
+}
+
+static inline unsigned char* wb_mask(const write_buffer* wb, int entry)
+{
+    return wb->mask + (size_t) entry * wb->block_size;
+}
+
+// 1 if every byte of entry has been stored
+int wb_covers(const write_buffer* wb, int entry);
+
+void wb_free(write_buffer* wb);
+
+#endif